@@ -0,0 +1,1059 @@
+#include "cpu.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace openhedz::emutest
+{
+    static constexpr uint8_t kOpHlt = 0xF4;
+
+    // Return address of Cpu::call, a trap in a page that is only mapped for it.
+    static constexpr uint32_t kReturnAddress = 0xFFFFF000;
+
+    static constexpr uint32_t kStackBase = 0x7FF00000;
+    static constexpr uint32_t kStackSize = 0x00100000;
+
+    enum AluOp : uint32_t
+    {
+        Add,
+        Or,
+        Adc,
+        Sbb,
+        And,
+        Sub,
+        Xor,
+        Cmp,
+    };
+
+    enum ShiftOp : uint32_t
+    {
+        Rol,
+        Ror,
+        Rcl,
+        Rcr,
+        Shl,
+        Shr,
+        Sal,
+        Sar,
+    };
+
+    static uint32_t getMask(uint32_t size)
+    {
+        return size == 4 ? 0xFFFFFFFFu : (1u << (size * 8)) - 1u;
+    }
+
+    static uint32_t getSignBit(uint32_t size)
+    {
+        return 1u << (size * 8 - 1);
+    }
+
+    static uint32_t signExtend(uint32_t value, uint32_t size)
+    {
+        if (size == 1)
+            return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(value)));
+        if (size == 2)
+            return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(value)));
+        return value;
+    }
+
+    Cpu::Cpu()
+        : _pages(size_t{ 1 } << (32 - kPageBits))
+    {
+        map(kStackBase, kStackSize);
+
+        map(kReturnAddress, kPageSize);
+        std::memset(getPage(kReturnAddress), kOpHlt, kPageSize);
+    }
+
+    void Cpu::map(uint32_t address, uint32_t size)
+    {
+        if (size == 0)
+            return;
+
+        const uint32_t first = address >> kPageBits;
+        const uint32_t last = static_cast<uint32_t>((static_cast<uint64_t>(address) + size - 1) >> kPageBits);
+        for (uint32_t page = first; page <= last; ++page)
+        {
+            if (!_pages[page])
+                _pages[page] = std::make_unique<uint8_t[]>(kPageSize);
+        }
+    }
+
+    bool Cpu::isMapped(uint32_t address) const
+    {
+        return getPage(address) != nullptr;
+    }
+
+    bool Cpu::read(uint32_t address, void* data, size_t size)
+    {
+        auto* out = static_cast<uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const uint32_t addr = address + static_cast<uint32_t>(i);
+            const uint8_t* page = getPage(addr);
+            if (page == nullptr)
+                return false;
+            out[i] = page[addr & (kPageSize - 1)];
+        }
+        return true;
+    }
+
+    bool Cpu::write(uint32_t address, const void* data, size_t size)
+    {
+        const auto* in = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const uint32_t addr = address + static_cast<uint32_t>(i);
+            uint8_t* page = getPage(addr);
+            if (page == nullptr)
+                return false;
+            page[addr & (kPageSize - 1)] = in[i];
+        }
+        return true;
+    }
+
+    uint32_t Cpu::load(uint32_t address, uint32_t size)
+    {
+        const uint32_t offset = address & (kPageSize - 1);
+        const uint8_t* page = getPage(address);
+        if (page != nullptr && offset + size <= kPageSize)
+        {
+            uint32_t value = 0;
+            std::memcpy(&value, page + offset, size);
+            return value;
+        }
+
+        uint32_t value = 0;
+        if (!read(address, &value, size))
+            fault("read of %u bytes at unmapped 0x%08X", size, address);
+        return value;
+    }
+
+    void Cpu::store(uint32_t address, uint32_t size, uint32_t value)
+    {
+        const uint32_t offset = address & (kPageSize - 1);
+        uint8_t* page = getPage(address);
+        if (page != nullptr && offset + size <= kPageSize)
+        {
+            std::memcpy(page + offset, &value, size);
+            return;
+        }
+
+        if (!write(address, &value, size))
+            fault("write of %u bytes at unmapped 0x%08X", size, address);
+    }
+
+    uint8_t Cpu::fetch8()
+    {
+        const uint8_t value = static_cast<uint8_t>(load(_eip, 1));
+        _eip += 1;
+        return value;
+    }
+
+    uint16_t Cpu::fetch16()
+    {
+        const uint16_t value = static_cast<uint16_t>(load(_eip, 2));
+        _eip += 2;
+        return value;
+    }
+
+    uint32_t Cpu::fetch32()
+    {
+        const uint32_t value = load(_eip, 4);
+        _eip += 4;
+        return value;
+    }
+
+    uint32_t Cpu::fetchImm(uint32_t size)
+    {
+        if (size == 1)
+            return fetch8();
+        if (size == 2)
+            return fetch16();
+        return fetch32();
+    }
+
+    void Cpu::push(uint32_t value)
+    {
+        _regs[Esp] -= 4;
+        store(_regs[Esp], 4, value);
+    }
+
+    uint32_t Cpu::pop()
+    {
+        const uint32_t value = load(_regs[Esp], 4);
+        _regs[Esp] += 4;
+        return value;
+    }
+
+    uint32_t Cpu::getRegister(uint32_t index, uint32_t size) const
+    {
+        if (size == 1)
+            return index < 4 ? _regs[index] & 0xFF : (_regs[index - 4] >> 8) & 0xFF;
+        return _regs[index] & getMask(size);
+    }
+
+    void Cpu::setRegister(uint32_t index, uint32_t size, uint32_t value)
+    {
+        if (size == 4)
+            _regs[index] = value;
+        else if (size == 2)
+            _regs[index] = (_regs[index] & 0xFFFF0000u) | (value & 0xFFFFu);
+        else if (index < 4)
+            _regs[index] = (_regs[index] & 0xFFFFFF00u) | (value & 0xFFu);
+        else
+            _regs[index - 4] = (_regs[index - 4] & 0xFFFF00FFu) | ((value & 0xFFu) << 8);
+    }
+
+    Cpu::ModRm Cpu::decodeModRm()
+    {
+        const uint8_t byte = fetch8();
+
+        ModRm modRm{};
+        modRm.mod = byte >> 6;
+        modRm.reg = (byte >> 3) & 7;
+        modRm.rm = byte & 7;
+        if (modRm.mod == 3)
+            return modRm;
+
+        uint32_t address = 0;
+        if (modRm.rm == 4)
+        {
+            const uint8_t sib = fetch8();
+            const uint32_t scale = sib >> 6;
+            const uint32_t index = (sib >> 3) & 7;
+            const uint32_t base = sib & 7;
+
+            if (index != 4)
+                address += _regs[index] << scale;
+            if (base == 5 && modRm.mod == 0)
+                address += fetch32();
+            else
+                address += _regs[base];
+        }
+        else if (modRm.rm == 5 && modRm.mod == 0)
+        {
+            address = fetch32();
+        }
+        else
+        {
+            address = _regs[modRm.rm];
+        }
+
+        if (modRm.mod == 1)
+            address += signExtend(fetch8(), 1);
+        else if (modRm.mod == 2)
+            address += fetch32();
+
+        modRm.address = address;
+        return modRm;
+    }
+
+    uint32_t Cpu::readRm(const ModRm& modRm, uint32_t size)
+    {
+        if (modRm.mod == 3)
+            return getRegister(modRm.rm, size);
+        return load(modRm.address, size);
+    }
+
+    void Cpu::writeRm(const ModRm& modRm, uint32_t size, uint32_t value)
+    {
+        if (modRm.mod == 3)
+            setRegister(modRm.rm, size, value);
+        else
+            store(modRm.address, size, value);
+    }
+
+    void Cpu::setResultFlags(uint32_t result, uint32_t size)
+    {
+        result &= getMask(size);
+        _zf = result == 0;
+        _sf = (result & getSignBit(size)) != 0;
+
+        uint8_t low = static_cast<uint8_t>(result);
+        low ^= low >> 4;
+        low ^= low >> 2;
+        low ^= low >> 1;
+        _pf = (low & 1) == 0;
+    }
+
+    uint32_t Cpu::alu(uint32_t op, uint32_t a, uint32_t b, uint32_t size)
+    {
+        const uint32_t mask = getMask(size);
+        const uint32_t sign = getSignBit(size);
+        a &= mask;
+        b &= mask;
+
+        uint32_t result = 0;
+        switch (op)
+        {
+            case Add:
+            case Adc:
+            {
+                const uint64_t full = static_cast<uint64_t>(a) + b + (op == Adc && _cf ? 1 : 0);
+                result = static_cast<uint32_t>(full) & mask;
+                _cf = full > mask;
+                _of = ((a ^ result) & (b ^ result) & sign) != 0;
+                break;
+            }
+            case Sub:
+            case Sbb:
+            case Cmp:
+            {
+                const uint64_t subtrahend = static_cast<uint64_t>(b) + (op == Sbb && _cf ? 1 : 0);
+                result = static_cast<uint32_t>(a - subtrahend) & mask;
+                _cf = subtrahend > a;
+                _of = ((a ^ b) & (a ^ result) & sign) != 0;
+                break;
+            }
+            case Or:
+                result = a | b;
+                _cf = _of = false;
+                break;
+            case And:
+                result = a & b;
+                _cf = _of = false;
+                break;
+            default:
+                result = a ^ b;
+                _cf = _of = false;
+                break;
+        }
+
+        setResultFlags(result, size);
+        return result;
+    }
+
+    uint32_t Cpu::shift(uint32_t op, uint32_t value, uint32_t count, uint32_t size)
+    {
+        const uint32_t bits = size * 8;
+        const uint32_t mask = getMask(size);
+        const uint32_t sign = getSignBit(size);
+        value &= mask;
+        count &= 31;
+        if (count == 0)
+            return value;
+
+        uint32_t result = 0;
+        switch (op)
+        {
+            case Rol:
+                count %= bits;
+                result = count == 0 ? value : ((value << count) | (value >> (bits - count))) & mask;
+                _cf = (result & 1) != 0;
+                _of = ((result & sign) != 0) != _cf;
+                return result;
+            case Ror:
+                count %= bits;
+                result = count == 0 ? value : ((value >> count) | (value << (bits - count))) & mask;
+                _cf = (result & sign) != 0;
+                _of = ((result ^ (result << 1)) & sign) != 0;
+                return result;
+            case Shl:
+            case Sal:
+                result = count >= bits ? 0 : (value << count) & mask;
+                _cf = count <= bits && ((static_cast<uint64_t>(value) >> (bits - count)) & 1) != 0;
+                _of = ((result & sign) != 0) != _cf;
+                break;
+            case Shr:
+                result = count >= bits ? 0 : value >> count;
+                _cf = count <= bits && ((value >> (count - 1)) & 1) != 0;
+                _of = (value & sign) != 0;
+                break;
+            case Sar:
+            {
+                const int32_t signedValue = static_cast<int32_t>(signExtend(value, size));
+                const uint32_t clamped = count >= bits ? bits - 1 : count;
+                result = static_cast<uint32_t>(signedValue >> clamped) & mask;
+                _cf = ((signedValue >> (count >= bits ? bits - 1 : count - 1)) & 1) != 0;
+                _of = false;
+                break;
+            }
+            default:
+                fault("unsupported rotate through carry");
+                return value;
+        }
+
+        setResultFlags(result, size);
+        return result;
+    }
+
+    uint32_t Cpu::incDec(uint32_t value, bool isDec, uint32_t size)
+    {
+        // Same as add and sub with 1 except that the carry flag is kept.
+        const bool cf = _cf;
+        const uint32_t result = alu(isDec ? Sub : Add, value, 1, size);
+        _cf = cf;
+        return result;
+    }
+
+    bool Cpu::condition(uint32_t cc) const
+    {
+        bool result = false;
+        switch (cc >> 1)
+        {
+            case 0:
+                result = _of;
+                break;
+            case 1:
+                result = _cf;
+                break;
+            case 2:
+                result = _zf;
+                break;
+            case 3:
+                result = _cf || _zf;
+                break;
+            case 4:
+                result = _sf;
+                break;
+            case 5:
+                result = _pf;
+                break;
+            case 6:
+                result = _sf != _of;
+                break;
+            default:
+                result = _zf || _sf != _of;
+                break;
+        }
+        return (cc & 1) != 0 ? !result : result;
+    }
+
+    void Cpu::group3(const ModRm& modRm, uint32_t size)
+    {
+        const uint32_t mask = getMask(size);
+        const uint32_t value = readRm(modRm, size);
+
+        switch (modRm.reg)
+        {
+            case 0:
+            case 1:
+                alu(And, value, fetchImm(size), size);
+                break;
+            case 2:
+                writeRm(modRm, size, ~value & mask);
+                break;
+            case 3:
+                writeRm(modRm, size, alu(Sub, 0, value, size));
+                break;
+            case 4:
+            case 5:
+            {
+                const uint32_t bits = size * 8;
+                const bool isSigned = modRm.reg == 5;
+
+                uint64_t product = static_cast<uint64_t>(getRegister(Eax, size)) * value;
+                if (isSigned)
+                {
+                    const int64_t a = static_cast<int32_t>(signExtend(getRegister(Eax, size), size));
+                    const int64_t b = static_cast<int32_t>(signExtend(value, size));
+                    product = static_cast<uint64_t>(a * b);
+                }
+
+                const uint32_t low = static_cast<uint32_t>(product) & mask;
+                const uint32_t high = static_cast<uint32_t>(product >> bits) & mask;
+                if (size == 1)
+                {
+                    setRegister(Eax, 2, (high << 8) | low);
+                }
+                else
+                {
+                    setRegister(Eax, size, low);
+                    setRegister(Edx, size, high);
+                }
+
+                // Set when the upper half is more than the extension of the lower half.
+                if (isSigned)
+                    _cf = _of = static_cast<int64_t>(product) != static_cast<int32_t>(signExtend(low, size));
+                else
+                    _cf = _of = high != 0;
+                break;
+            }
+            default:
+            {
+                if (value == 0)
+                {
+                    fault("division by zero");
+                    return;
+                }
+
+                const uint32_t bits = size * 8;
+                const bool isSigned = modRm.reg == 7;
+                const uint64_t dividend = size == 1
+                    ? getRegister(Eax, 2)
+                    : (static_cast<uint64_t>(getRegister(Edx, size)) << bits) | getRegister(Eax, size);
+
+                uint64_t quotient = 0;
+                uint64_t remainder = 0;
+                bool overflow = false;
+                if (isSigned)
+                {
+                    const int64_t signedDividend = bits == 32
+                        ? static_cast<int64_t>(dividend)
+                        : static_cast<int64_t>(dividend << (64 - bits * 2)) >> (64 - bits * 2);
+                    const int64_t divisor = static_cast<int32_t>(signExtend(value, size));
+                    const int64_t q = signedDividend / divisor;
+                    overflow = q > static_cast<int64_t>(mask >> 1) || q < -static_cast<int64_t>(mask >> 1) - 1;
+                    quotient = static_cast<uint64_t>(q);
+                    remainder = static_cast<uint64_t>(signedDividend % divisor);
+                }
+                else
+                {
+                    quotient = dividend / value;
+                    remainder = dividend % value;
+                    overflow = quotient > mask;
+                }
+
+                if (overflow)
+                {
+                    fault("division overflow");
+                    return;
+                }
+
+                if (size == 1)
+                {
+                    const uint32_t low = static_cast<uint32_t>(quotient) & mask;
+                    setRegister(Eax, 2, ((static_cast<uint32_t>(remainder) & mask) << 8) | low);
+                }
+                else
+                {
+                    setRegister(Eax, size, static_cast<uint32_t>(quotient));
+                    setRegister(Edx, size, static_cast<uint32_t>(remainder));
+                }
+                break;
+            }
+        }
+    }
+
+    void Cpu::stringOp(uint8_t opcode, uint32_t size, bool rep)
+    {
+        const uint32_t delta = _df ? 0u - size : size;
+
+        uint32_t count = rep ? _regs[Ecx] : 1;
+        for (; count != 0 && _error.empty(); --count)
+        {
+            if (opcode == 0xA4 || opcode == 0xA5)
+            {
+                store(_regs[Edi], size, load(_regs[Esi], size));
+                _regs[Esi] += delta;
+            }
+            else
+            {
+                store(_regs[Edi], size, getRegister(Eax, size));
+            }
+            _regs[Edi] += delta;
+        }
+
+        if (rep)
+            _regs[Ecx] = count;
+    }
+
+    void Cpu::addStub(uint32_t address, StubFn fn, void* user)
+    {
+        map(address, 1);
+        store(address, 1, kOpHlt);
+        _stubs[address] = Stub{ fn, user };
+    }
+
+    uint32_t Cpu::getStubArg(size_t index)
+    {
+        return load(_regs[Esp] + 4 + static_cast<uint32_t>(index) * 4, 4);
+    }
+
+    void Cpu::returnFromStub(uint32_t result, uint32_t stackBytes)
+    {
+        _regs[Eax] = result;
+        _eip = pop();
+        _regs[Esp] += stackBytes;
+    }
+
+    void Cpu::fault(const char* fmt, ...)
+    {
+        if (!_error.empty())
+            return;
+
+        char buffer[256];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buffer, sizeof(buffer), fmt, args);
+        va_end(args);
+
+        char location[64];
+        snprintf(location, sizeof(location), " (instruction at 0x%08X)", _instrStart);
+        _error = std::string(buffer) + location;
+    }
+
+    bool Cpu::call(uint32_t address, std::initializer_list<uint32_t> args, uint32_t& result)
+    {
+        _error.clear();
+
+        const uint32_t stackTop = kStackBase + kStackSize - 16;
+        _regs[Esp] = stackTop;
+        for (auto it = args.end(); it != args.begin();)
+        {
+            push(*--it);
+        }
+        push(kReturnAddress);
+        _eip = address;
+        _df = false;
+
+        const uint64_t limit = _instrCount + _instrLimit;
+        while (_error.empty())
+        {
+            if (_eip == kReturnAddress)
+                break;
+
+            if (_instrCount >= limit)
+            {
+                fault("instruction limit reached");
+                break;
+            }
+            step();
+        }
+
+        if (!_error.empty())
+            return false;
+
+        // Arguments are removed by the caller with cdecl, anything else means the callee popped them.
+        if (_regs[Esp] != stackTop - static_cast<uint32_t>(args.size()) * 4)
+        {
+            fault("unbalanced stack on return, esp 0x%08X", _regs[Esp]);
+            return false;
+        }
+
+        result = _regs[Eax];
+        return true;
+    }
+
+    void Cpu::step()
+    {
+        _instrStart = _eip;
+        _instrCount++;
+
+        uint32_t size = 4;
+        bool rep = false;
+
+        uint8_t opcode = fetch8();
+        for (;; opcode = fetch8())
+        {
+            if (opcode == 0x66)
+                size = 2;
+            else if (opcode == 0xF2 || opcode == 0xF3)
+                rep = true;
+            else if (opcode != 0x26 && opcode != 0x2E && opcode != 0x36 && opcode != 0x3E)
+                break;
+        }
+
+        // add, or, adc, sbb, and, sub, xor and cmp in their six encodings.
+        if (opcode < 0x40 && (opcode & 7) < 6)
+        {
+            const uint32_t op = opcode >> 3;
+            const uint32_t opSize = (opcode & 1) != 0 ? size : 1;
+            switch (opcode & 7)
+            {
+                case 0:
+                case 1:
+                {
+                    const ModRm modRm = decodeModRm();
+                    const uint32_t result = alu(op, readRm(modRm, opSize), getRegister(modRm.reg, opSize), opSize);
+                    if (op != Cmp)
+                        writeRm(modRm, opSize, result);
+                    break;
+                }
+                case 2:
+                case 3:
+                {
+                    const ModRm modRm = decodeModRm();
+                    const uint32_t result = alu(op, getRegister(modRm.reg, opSize), readRm(modRm, opSize), opSize);
+                    if (op != Cmp)
+                        setRegister(modRm.reg, opSize, result);
+                    break;
+                }
+                default:
+                {
+                    const uint32_t result = alu(op, getRegister(Eax, opSize), fetchImm(opSize), opSize);
+                    if (op != Cmp)
+                        setRegister(Eax, opSize, result);
+                    break;
+                }
+            }
+            return;
+        }
+
+        switch (opcode)
+        {
+            case 0x0F:
+                stepExtended();
+                break;
+            case 0x40:
+            case 0x41:
+            case 0x42:
+            case 0x43:
+            case 0x44:
+            case 0x45:
+            case 0x46:
+            case 0x47:
+            case 0x48:
+            case 0x49:
+            case 0x4A:
+            case 0x4B:
+            case 0x4C:
+            case 0x4D:
+            case 0x4E:
+            case 0x4F:
+                setRegister(opcode & 7, size, incDec(getRegister(opcode & 7, size), opcode >= 0x48, size));
+                break;
+            case 0x50:
+            case 0x51:
+            case 0x52:
+            case 0x53:
+            case 0x54:
+            case 0x55:
+            case 0x56:
+            case 0x57:
+                push(_regs[opcode & 7]);
+                break;
+            case 0x58:
+            case 0x59:
+            case 0x5A:
+            case 0x5B:
+            case 0x5C:
+            case 0x5D:
+            case 0x5E:
+            case 0x5F:
+                _regs[opcode & 7] = pop();
+                break;
+            case 0x68:
+                push(fetch32());
+                break;
+            case 0x6A:
+                push(signExtend(fetch8(), 1));
+                break;
+            case 0x69:
+            case 0x6B:
+            {
+                const ModRm modRm = decodeModRm();
+                const int64_t a = static_cast<int32_t>(signExtend(readRm(modRm, size), size));
+                const uint32_t imm = opcode == 0x6B ? signExtend(fetch8(), 1) : signExtend(fetchImm(size), size);
+                const int64_t b = static_cast<int32_t>(imm);
+                const int64_t product = a * b;
+                const uint32_t result = static_cast<uint32_t>(product) & getMask(size);
+                setRegister(modRm.reg, size, result);
+                _cf = _of = static_cast<int64_t>(static_cast<int32_t>(signExtend(result, size))) != product;
+                break;
+            }
+            case 0x70:
+            case 0x71:
+            case 0x72:
+            case 0x73:
+            case 0x74:
+            case 0x75:
+            case 0x76:
+            case 0x77:
+            case 0x78:
+            case 0x79:
+            case 0x7A:
+            case 0x7B:
+            case 0x7C:
+            case 0x7D:
+            case 0x7E:
+            case 0x7F:
+            {
+                const uint32_t target = _eip + 1 + signExtend(load(_eip, 1), 1);
+                _eip = condition(opcode & 0x0F) ? target : _eip + 1;
+                break;
+            }
+            case 0x80:
+            case 0x81:
+            case 0x82:
+            case 0x83:
+            {
+                const uint32_t opSize = opcode == 0x81 || opcode == 0x83 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                const uint32_t imm = opcode == 0x83 ? signExtend(fetch8(), 1) : fetchImm(opSize);
+                const uint32_t result = alu(modRm.reg, readRm(modRm, opSize), imm, opSize);
+                if (modRm.reg != Cmp)
+                    writeRm(modRm, opSize, result);
+                break;
+            }
+            case 0x84:
+            case 0x85:
+            {
+                const uint32_t opSize = opcode == 0x85 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                alu(And, readRm(modRm, opSize), getRegister(modRm.reg, opSize), opSize);
+                break;
+            }
+            case 0x86:
+            case 0x87:
+            {
+                const uint32_t opSize = opcode == 0x87 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                const uint32_t value = readRm(modRm, opSize);
+                writeRm(modRm, opSize, getRegister(modRm.reg, opSize));
+                setRegister(modRm.reg, opSize, value);
+                break;
+            }
+            case 0x88:
+            case 0x89:
+            {
+                const uint32_t opSize = opcode == 0x89 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                writeRm(modRm, opSize, getRegister(modRm.reg, opSize));
+                break;
+            }
+            case 0x8A:
+            case 0x8B:
+            {
+                const uint32_t opSize = opcode == 0x8B ? size : 1;
+                const ModRm modRm = decodeModRm();
+                setRegister(modRm.reg, opSize, readRm(modRm, opSize));
+                break;
+            }
+            case 0x8D:
+            {
+                const ModRm modRm = decodeModRm();
+                if (modRm.mod == 3)
+                    fault("lea with a register operand");
+                else
+                    setRegister(modRm.reg, size, modRm.address);
+                break;
+            }
+            case 0x8F:
+            {
+                // The address uses esp after the pop.
+                const uint32_t value = pop();
+                writeRm(decodeModRm(), size, value);
+                break;
+            }
+            case 0x90:
+                break;
+            case 0x91:
+            case 0x92:
+            case 0x93:
+            case 0x94:
+            case 0x95:
+            case 0x96:
+            case 0x97:
+            {
+                const uint32_t value = getRegister(opcode & 7, size);
+                setRegister(opcode & 7, size, getRegister(Eax, size));
+                setRegister(Eax, size, value);
+                break;
+            }
+            case 0x98:
+                setRegister(Eax, size, signExtend(getRegister(Eax, size / 2), size / 2));
+                break;
+            case 0x99:
+                setRegister(Edx, size, (getRegister(Eax, size) & getSignBit(size)) != 0 ? getMask(size) : 0);
+                break;
+            case 0xA0:
+            case 0xA1:
+            {
+                const uint32_t opSize = opcode == 0xA1 ? size : 1;
+                setRegister(Eax, opSize, load(fetch32(), opSize));
+                break;
+            }
+            case 0xA2:
+            case 0xA3:
+            {
+                const uint32_t opSize = opcode == 0xA3 ? size : 1;
+                store(fetch32(), opSize, getRegister(Eax, opSize));
+                break;
+            }
+            case 0xA4:
+            case 0xA5:
+            case 0xAA:
+            case 0xAB:
+                stringOp(opcode, (opcode & 1) != 0 ? size : 1, rep);
+                break;
+            case 0xA8:
+            case 0xA9:
+            {
+                const uint32_t opSize = opcode == 0xA9 ? size : 1;
+                alu(And, getRegister(Eax, opSize), fetchImm(opSize), opSize);
+                break;
+            }
+            case 0xB0:
+            case 0xB1:
+            case 0xB2:
+            case 0xB3:
+            case 0xB4:
+            case 0xB5:
+            case 0xB6:
+            case 0xB7:
+                setRegister(opcode & 7, 1, fetch8());
+                break;
+            case 0xB8:
+            case 0xB9:
+            case 0xBA:
+            case 0xBB:
+            case 0xBC:
+            case 0xBD:
+            case 0xBE:
+            case 0xBF:
+                setRegister(opcode & 7, size, fetchImm(size));
+                break;
+            case 0xC0:
+            case 0xC1:
+            case 0xD0:
+            case 0xD1:
+            case 0xD2:
+            case 0xD3:
+            {
+                const uint32_t opSize = (opcode & 1) != 0 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                uint32_t count = 1;
+                if (opcode <= 0xC1)
+                    count = fetch8();
+                else if (opcode >= 0xD2)
+                    count = getRegister(Ecx, 1);
+                writeRm(modRm, opSize, shift(modRm.reg, readRm(modRm, opSize), count, opSize));
+                break;
+            }
+            case 0xC2:
+            {
+                const uint16_t bytes = fetch16();
+                _eip = pop();
+                _regs[Esp] += bytes;
+                break;
+            }
+            case 0xC3:
+                _eip = pop();
+                break;
+            case 0xC6:
+            case 0xC7:
+            {
+                const uint32_t opSize = opcode == 0xC7 ? size : 1;
+                const ModRm modRm = decodeModRm();
+                writeRm(modRm, opSize, fetchImm(opSize));
+                break;
+            }
+            case 0xC9:
+                _regs[Esp] = _regs[Ebp];
+                _regs[Ebp] = pop();
+                break;
+            case 0xE8:
+            {
+                const uint32_t offset = fetch32();
+                push(_eip);
+                _eip += offset;
+                break;
+            }
+            case 0xE9:
+            {
+                const uint32_t offset = fetch32();
+                _eip += offset;
+                break;
+            }
+            case 0xEB:
+            {
+                const uint32_t offset = signExtend(fetch8(), 1);
+                _eip += offset;
+                break;
+            }
+            case kOpHlt:
+            {
+                auto it = _stubs.find(_instrStart);
+                if (it == _stubs.end())
+                {
+                    fault("hlt outside of a stub");
+                    break;
+                }
+                _eip = _instrStart;
+                it->second.fn(*this, it->second.user);
+                break;
+            }
+            case 0xF6:
+            case 0xF7:
+                group3(decodeModRm(), opcode == 0xF7 ? size : 1);
+                break;
+            case 0xFC:
+                _df = false;
+                break;
+            case 0xFD:
+                _df = true;
+                break;
+            case 0xFE:
+            case 0xFF:
+            {
+                const uint32_t opSize = opcode == 0xFF ? size : 1;
+                const ModRm modRm = decodeModRm();
+                if (modRm.reg <= 1)
+                {
+                    writeRm(modRm, opSize, incDec(readRm(modRm, opSize), modRm.reg == 1, opSize));
+                }
+                else if (opcode == 0xFF && modRm.reg == 2)
+                {
+                    const uint32_t target = readRm(modRm, 4);
+                    push(_eip);
+                    _eip = target;
+                }
+                else if (opcode == 0xFF && modRm.reg == 4)
+                {
+                    _eip = readRm(modRm, 4);
+                }
+                else if (opcode == 0xFF && modRm.reg == 6)
+                {
+                    push(readRm(modRm, 4));
+                }
+                else
+                {
+                    fault("unsupported opcode %02X /%u", opcode, modRm.reg);
+                }
+                break;
+            }
+            default:
+                fault("unsupported opcode %02X", opcode);
+                break;
+        }
+    }
+
+    void Cpu::stepExtended()
+    {
+        const uint8_t opcode = fetch8();
+        if (opcode >= 0x80 && opcode <= 0x8F)
+        {
+            const uint32_t offset = fetch32();
+            if (condition(opcode & 0x0F))
+                _eip += offset;
+            return;
+        }
+
+        if (opcode >= 0x90 && opcode <= 0x9F)
+        {
+            writeRm(decodeModRm(), 1, condition(opcode & 0x0F) ? 1 : 0);
+            return;
+        }
+
+        switch (opcode)
+        {
+            case 0xAF:
+            {
+                const ModRm modRm = decodeModRm();
+                const int64_t product = static_cast<int64_t>(static_cast<int32_t>(getRegister(modRm.reg, 4)))
+                    * static_cast<int32_t>(readRm(modRm, 4));
+                setRegister(modRm.reg, 4, static_cast<uint32_t>(product));
+                _cf = _of = static_cast<int64_t>(static_cast<int32_t>(product)) != product;
+                break;
+            }
+            case 0xB6:
+            case 0xB7:
+            case 0xBE:
+            case 0xBF:
+            {
+                const uint32_t srcSize = (opcode & 1) != 0 ? 2 : 1;
+                const ModRm modRm = decodeModRm();
+                const uint32_t value = readRm(modRm, srcSize);
+                setRegister(modRm.reg, 4, opcode >= 0xBE ? signExtend(value, srcSize) : value);
+                break;
+            }
+            default:
+                fault("unsupported opcode 0F %02X", opcode);
+                break;
+        }
+    }
+
+} // namespace openhedz::emutest
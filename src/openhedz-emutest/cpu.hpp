@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace openhedz::emutest
+{
+    enum Reg
+    {
+        Eax,
+        Ecx,
+        Edx,
+        Ebx,
+        Esp,
+        Ebp,
+        Esi,
+        Edi,
+    };
+
+    class Cpu;
+
+    // Runs in place of the code at the stub address, has to return through Cpu::returnFromStub.
+    using StubFn = void (*)(Cpu& cpu, void* user);
+
+    // Interpreter for the 32-bit integer subset of x86 that compiled game code uses, no FPU, SSE or
+    // segments. Memory is a flat 4 GiB space where only mapped pages are accessible, any other access
+    // stops the run with an error.
+    class Cpu
+    {
+        struct Stub
+        {
+            StubFn fn;
+            void* user;
+        };
+
+        struct ModRm
+        {
+            uint8_t mod;
+            uint8_t reg;
+            uint8_t rm;
+            uint32_t address;
+        };
+
+        static constexpr uint32_t kPageBits = 12;
+        static constexpr uint32_t kPageSize = 1u << kPageBits;
+
+        std::vector<std::unique_ptr<uint8_t[]>> _pages;
+        std::unordered_map<uint32_t, Stub> _stubs;
+
+        uint32_t _regs[8]{};
+        uint32_t _eip = 0;
+        bool _cf = false;
+        bool _pf = false;
+        bool _zf = false;
+        bool _sf = false;
+        bool _df = false;
+        bool _of = false;
+
+        uint32_t _instrStart = 0;
+        uint64_t _instrCount = 0;
+        uint64_t _instrLimit = 1'000'000'000;
+        std::string _error;
+
+    public:
+        Cpu();
+
+        // Maps zero filled pages covering the range, pages that are already mapped keep their content.
+        void map(uint32_t address, uint32_t size);
+        bool isMapped(uint32_t address) const;
+
+        bool read(uint32_t address, void* data, size_t size);
+        bool write(uint32_t address, const void* data, size_t size);
+
+        uint32_t read32(uint32_t address)
+        {
+            return load(address, 4);
+        }
+
+        void write32(uint32_t address, uint32_t value)
+        {
+            store(address, 4, value);
+        }
+
+        uint32_t getReg(Reg reg) const
+        {
+            return _regs[reg];
+        }
+
+        void setReg(Reg reg, uint32_t value)
+        {
+            _regs[reg] = value;
+        }
+
+        uint64_t getInstructionCount() const
+        {
+            return _instrCount;
+        }
+
+        // Upper bound of instructions for a single call, protects against code that never returns.
+        void setInstructionLimit(uint64_t limit)
+        {
+            _instrLimit = limit;
+        }
+
+        const std::string& getError() const
+        {
+            return _error;
+        }
+
+        // Executes the stub instead of the code at address, the first byte there is replaced by a trap.
+        void addStub(uint32_t address, StubFn fn, void* user);
+
+        // Argument of the stub being executed, index 0 is the first argument of a cdecl or stdcall function.
+        uint32_t getStubArg(size_t index);
+
+        // Returns to the caller of the stub, stackBytes is the size of the arguments for stdcall functions.
+        void returnFromStub(uint32_t result, uint32_t stackBytes = 0);
+
+        // Stops the run with an error, usable from stubs.
+        void fault(const char* fmt, ...);
+
+        // Calls a cdecl function and runs until it returns, false if it faulted or the stack is unbalanced.
+        bool call(uint32_t address, std::initializer_list<uint32_t> args, uint32_t& result);
+
+    private:
+        uint8_t* getPage(uint32_t address) const
+        {
+            return _pages[address >> kPageBits].get();
+        }
+
+        uint32_t load(uint32_t address, uint32_t size);
+        void store(uint32_t address, uint32_t size, uint32_t value);
+
+        uint8_t fetch8();
+        uint16_t fetch16();
+        uint32_t fetch32();
+        uint32_t fetchImm(uint32_t size);
+
+        void push(uint32_t value);
+        uint32_t pop();
+
+        uint32_t getRegister(uint32_t index, uint32_t size) const;
+        void setRegister(uint32_t index, uint32_t size, uint32_t value);
+
+        ModRm decodeModRm();
+        uint32_t readRm(const ModRm& modRm, uint32_t size);
+        void writeRm(const ModRm& modRm, uint32_t size, uint32_t value);
+
+        void setResultFlags(uint32_t result, uint32_t size);
+        uint32_t alu(uint32_t op, uint32_t a, uint32_t b, uint32_t size);
+        uint32_t shift(uint32_t op, uint32_t value, uint32_t count, uint32_t size);
+        uint32_t incDec(uint32_t value, bool isDec, uint32_t size);
+        bool condition(uint32_t cc) const;
+
+        void group3(const ModRm& modRm, uint32_t size);
+        void stringOp(uint8_t opcode, uint32_t size, bool rep);
+        void step();
+        void stepExtended();
+    };
+
+} // namespace openhedz::emutest
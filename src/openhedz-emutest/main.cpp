@@ -0,0 +1,380 @@
+// Differential test of reimplemented functions against the original code of Hedz.exe, the sections of
+// the executable are mapped into an x86 interpreter and the original functions are called at their
+// address with generated inputs. CRT and Windows functions they call are replaced by stubs. Only
+// depends on the standard library so it builds on any platform, for example:
+//   g++ -std=c++17 -O2 -I src src/openhedz-emutest/*.cpp src/openhedz-hookcheck/peimage.cpp
+//       src/openhedz-textpack/fuzz.cpp src/openhedz-textpack/referencedecoder.cpp
+//       src/openhedz/utils/textcompress.cpp src/openhedz/utils/textdecoder.cpp -o emutest
+//   ./emutest bin/Hedz.exe
+#include "cpu.hpp"
+
+#include <openhedz-hookcheck/peimage.hpp>
+#include <openhedz-textpack/fuzz.hpp>
+#include <openhedz-textpack/referencedecoder.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openhedz;
+using namespace openhedz::emutest;
+
+namespace
+{
+    // Functions and variables of Hedz.exe.
+    constexpr uint32_t kDecompressText = 0x00424A20;
+    constexpr uint32_t kInitRand = 0x0045E9C0;
+    constexpr uint32_t kChkStk = 0x004AD310;
+    constexpr uint32_t kFree = 0x004AD4B0;
+    constexpr uint32_t kMemset = 0x004AD5E0;
+    constexpr uint32_t kMalloc = 0x004AD640;
+    constexpr uint32_t kGetPtd = 0x004B5DF0;
+    constexpr uint32_t kImportWaitForSingleObject = 0x004C01B0;
+    constexpr uint32_t kImportReleaseMutex = 0x004C01B4;
+    constexpr uint32_t kRandValueTable = 0x005DC800;
+
+    // std::size(gRandValueTable), initRand fills the table with one rand() call per entry.
+    constexpr uint32_t kRandValueCount = 255;
+
+    // Offset of the rand() state in the per thread data of the CRT.
+    constexpr uint32_t kPtdRandSeed = 0x14;
+
+    // Memory used by the harness, away from the image.
+    constexpr uint32_t kHeapBase = 0x20000000;
+    constexpr uint32_t kPtdAddress = 0x30000000;
+    constexpr uint32_t kResultAddress = 0x30001000;
+    // Blobs end at this address and the page after it is never mapped, reading past the blob faults.
+    constexpr uint32_t kInputEnd = 0x50000000;
+    constexpr uint32_t kImportStubs = 0xFFFE0000;
+
+    // malloc and free of the CRT, blocks are handed out without reuse and every free is checked.
+    class Heap
+    {
+        Cpu& _cpu;
+        uint32_t _next = kHeapBase;
+        std::map<uint32_t, uint32_t> _live;
+        uint64_t _numAllocs = 0;
+
+    public:
+        explicit Heap(Cpu& cpu)
+            : _cpu(cpu)
+        {
+        }
+
+        uint32_t alloc(uint32_t size)
+        {
+            const uint32_t address = _next;
+            _cpu.map(address, std::max(size, 1u));
+            _live[address] = size;
+            _next += (std::max(size, 1u) + 31u) & ~15u;
+            _numAllocs++;
+            return address;
+        }
+
+        bool free(uint32_t address)
+        {
+            if (address == 0)
+                return true;
+            return _live.erase(address) != 0;
+        }
+
+        // Starts over once nothing is allocated, keeps the address space of long runs bounded.
+        void reset()
+        {
+            if (_live.empty())
+                _next = kHeapBase;
+        }
+
+        const std::map<uint32_t, uint32_t>& getLive() const
+        {
+            return _live;
+        }
+
+        uint64_t getNumAllocs() const
+        {
+            return _numAllocs;
+        }
+    };
+
+    void stubMalloc(Cpu& cpu, void* user)
+    {
+        auto& heap = *static_cast<Heap*>(user);
+        cpu.returnFromStub(heap.alloc(cpu.getStubArg(0)));
+    }
+
+    void stubFree(Cpu& cpu, void* user)
+    {
+        auto& heap = *static_cast<Heap*>(user);
+        const uint32_t address = cpu.getStubArg(0);
+        if (!heap.free(address))
+        {
+            cpu.fault("free of 0x%08X which is not allocated", address);
+            return;
+        }
+        cpu.returnFromStub(0);
+    }
+
+    void stubMemset(Cpu& cpu, void*)
+    {
+        const uint32_t address = cpu.getStubArg(0);
+        const uint8_t value = static_cast<uint8_t>(cpu.getStubArg(1));
+        const uint32_t size = cpu.getStubArg(2);
+
+        const std::vector<uint8_t> fill(size, value);
+        if (!cpu.write(address, fill.data(), fill.size()))
+        {
+            cpu.fault("memset of %u bytes at unmapped 0x%08X", size, address);
+            return;
+        }
+        cpu.returnFromStub(address);
+    }
+
+    // Stack probe with the size in eax, leaves esp lowered by it on return.
+    void stubChkStk(Cpu& cpu, void*)
+    {
+        const uint32_t size = cpu.getReg(Eax);
+        const uint32_t esp = cpu.getReg(Esp);
+        cpu.returnFromStub(size);
+        cpu.setReg(Esp, esp + 4 - size);
+        cpu.setReg(Eax, size);
+    }
+
+    // Per thread data of the CRT, there is only the one thread of the interpreter.
+    void stubGetPtd(Cpu& cpu, void*)
+    {
+        cpu.returnFromStub(kPtdAddress);
+    }
+
+    void stubWaitForSingleObject(Cpu& cpu, void*)
+    {
+        cpu.returnFromStub(0, 8);
+    }
+
+    void stubReleaseMutex(Cpu& cpu, void*)
+    {
+        cpu.returnFromStub(1, 4);
+    }
+
+    void addImportStub(Cpu& cpu, uint32_t importAddress, StubFn fn, uint32_t& nextStub)
+    {
+        cpu.addStub(nextStub, fn, nullptr);
+        cpu.write32(importAddress, nextStub);
+        nextStub++;
+    }
+
+    void mapImage(Cpu& cpu, const hookcheck::PeImage& image)
+    {
+        for (const auto& section : image.getSections())
+        {
+            cpu.map(section.va, section.size);
+            if (section.data != nullptr)
+                cpu.write(section.va, section.data, section.dataSize);
+        }
+    }
+
+    // rand() of the CRT linked into the game and the wrapper.
+    uint32_t crtRand(uint32_t& seed)
+    {
+        seed = seed * 214013u + 2531011u;
+        return (seed >> 16) & 0x7FFF;
+    }
+
+    bool checkInitRand(Cpu& cpu, std::mt19937& rng, uint32_t numSeeds)
+    {
+        constexpr uint16_t kCanary = 0xCDCD;
+        constexpr uint32_t kNumCanaries = 8;
+
+        for (uint32_t i = 0; i < numSeeds; ++i)
+        {
+            // The first run uses the seed the CRT starts with when srand is never called.
+            const uint32_t seed = i == 0 ? 1u : static_cast<uint32_t>(rng());
+            cpu.write32(kPtdAddress + kPtdRandSeed, seed);
+
+            std::vector<uint16_t> table(kRandValueCount + kNumCanaries, kCanary);
+            cpu.write(kRandValueTable, table.data(), table.size() * sizeof(uint16_t));
+
+            uint32_t result = 0;
+            if (!cpu.call(kInitRand, {}, result))
+            {
+                fprintf(stderr, "initRand with seed %u: %s\n", seed, cpu.getError().c_str());
+                return false;
+            }
+            cpu.read(kRandValueTable, table.data(), table.size() * sizeof(uint16_t));
+
+            uint32_t expectedSeed = seed;
+            for (uint32_t n = 0; n < kRandValueCount; ++n)
+            {
+                const uint32_t expected = crtRand(expectedSeed);
+                if (table[n] != expected)
+                {
+                    fprintf(stderr, "initRand with seed %u: entry %u is %u, expected %u\n", seed, n, table[n], expected);
+                    return false;
+                }
+            }
+
+            const auto written = std::find_if(
+                table.begin() + kRandValueCount, table.end(), [](uint16_t value) { return value != kCanary; });
+            if (written != table.end())
+            {
+                fprintf(
+                    stderr, "initRand with seed %u: writes entry %zu past the %u of the table\n", seed,
+                    static_cast<size_t>(written - table.begin()), kRandValueCount);
+                return false;
+            }
+
+            if (cpu.read32(kPtdAddress + kPtdRandSeed) != expectedSeed)
+            {
+                fprintf(stderr, "initRand with seed %u: calls rand() more than %u times\n", seed, kRandValueCount);
+                return false;
+            }
+        }
+
+        printf("initRand        %u seeds OK\n", numSeeds);
+        return true;
+    }
+
+    // The original builds a tree without a single node below the root for such tables, it frees the root
+    // and then writes through its null parent.
+    bool hasCodes(const std::vector<uint8_t>& blob)
+    {
+        uint16_t numEntries = 0;
+        std::memcpy(&numEntries, blob.data(), sizeof(numEntries));
+        for (uint32_t i = 0; i < numEntries; ++i)
+        {
+            if (blob[6 + i * 6 + 5] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    void writeFailure(const std::vector<uint8_t>& blob)
+    {
+        std::ofstream fs("emutest-failure.hz", std::ios::binary);
+        fs.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+    }
+
+    bool checkDecompressText(Cpu& cpu, Heap& heap, std::mt19937& rng, uint32_t iterations)
+    {
+        using textpack::FuzzKind;
+
+        uint32_t counts[static_cast<size_t>(FuzzKind::Count)] = {};
+        uint32_t skipped = 0;
+        uint64_t outputBytes = 0;
+        const uint64_t instrBefore = cpu.getInstructionCount();
+        const uint64_t allocsBefore = heap.getNumAllocs();
+
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            const auto kind = static_cast<FuzzKind>(i % static_cast<uint32_t>(FuzzKind::Count));
+            const std::vector<uint8_t> blob = textpack::makeFuzzBlob(kind, rng);
+            if (!hasCodes(blob))
+            {
+                skipped++;
+                continue;
+            }
+
+            const uint32_t input = kInputEnd - static_cast<uint32_t>(blob.size());
+            cpu.map(input, static_cast<uint32_t>(blob.size()));
+            cpu.write(input, blob.data(), blob.size());
+
+            uint32_t output = 0;
+            if (!cpu.call(kDecompressText, { input, kResultAddress }, output))
+            {
+                fprintf(
+                    stderr, "decompressText iteration %u (%s): %s\n", i, textpack::getFuzzKindName(kind),
+                    cpu.getError().c_str());
+                writeFailure(blob);
+                return false;
+            }
+
+            const std::vector<uint8_t> expected = textpack::decodeTable(blob.data());
+            const uint32_t size = cpu.read32(kResultAddress);
+
+            std::vector<uint8_t> actual(size);
+            cpu.read(output, actual.data(), actual.size());
+            if (actual != expected)
+            {
+                const auto mismatch = std::mismatch(actual.begin(), actual.end(), expected.begin(), expected.end());
+                fprintf(
+                    stderr, "decompressText iteration %u (%s): %u bytes, TextDecoder %zu, first difference at %zu\n", i,
+                    textpack::getFuzzKindName(kind), size, expected.size(),
+                    static_cast<size_t>(mismatch.first - actual.begin()));
+                writeFailure(blob);
+                return false;
+            }
+
+            // Everything apart from the returned buffer has to be freed.
+            if (!heap.free(output) || !heap.getLive().empty())
+            {
+                fprintf(
+                    stderr, "decompressText iteration %u (%s): %zu blocks left allocated\n", i,
+                    textpack::getFuzzKindName(kind), heap.getLive().size());
+                return false;
+            }
+            heap.reset();
+
+            counts[static_cast<size_t>(kind)]++;
+            outputBytes += size;
+        }
+
+        printf("decompressText ");
+        for (size_t i = 0; i < static_cast<size_t>(FuzzKind::Count); ++i)
+        {
+            printf(" %s %u", textpack::getFuzzKindName(static_cast<FuzzKind>(i)), counts[i]);
+        }
+        printf(
+            ", %u without codes skipped, %llu bytes, %llu instructions, %llu allocations OK\n", skipped,
+            static_cast<unsigned long long>(outputBytes),
+            static_cast<unsigned long long>(cpu.getInstructionCount() - instrBefore),
+            static_cast<unsigned long long>(heap.getNumAllocs() - allocsBefore));
+        return true;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: emutest <Hedz.exe> [iterations] [seed]\n");
+        return EXIT_FAILURE;
+    }
+
+    const auto iterations = argc >= 3 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 200u;
+    const auto seed = argc >= 4 ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 1u;
+
+    hookcheck::PeImage image;
+    std::string error;
+    if (!image.load(argv[1], error))
+    {
+        fprintf(stderr, "Unable to load %s: %s\n", argv[1], error.c_str());
+        return EXIT_FAILURE;
+    }
+
+    Cpu cpu;
+    Heap heap(cpu);
+    mapImage(cpu, image);
+
+    cpu.addStub(kMalloc, stubMalloc, &heap);
+    cpu.addStub(kFree, stubFree, &heap);
+    cpu.addStub(kMemset, stubMemset, nullptr);
+    cpu.addStub(kChkStk, stubChkStk, nullptr);
+    cpu.addStub(kGetPtd, stubGetPtd, nullptr);
+
+    uint32_t nextStub = kImportStubs;
+    addImportStub(cpu, kImportWaitForSingleObject, stubWaitForSingleObject, nextStub);
+    addImportStub(cpu, kImportReleaseMutex, stubReleaseMutex, nextStub);
+
+    cpu.map(kPtdAddress, 0x1000);
+    cpu.map(kResultAddress, sizeof(uint32_t));
+
+    std::mt19937 rng(seed);
+    const bool ok = checkInitRand(cpu, rng, 16) && checkDecompressText(cpu, heap, rng, iterations);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
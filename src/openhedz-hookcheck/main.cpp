@@ -0,0 +1,303 @@
+// Checks the hook addresses of the sources against the original executable without running it:
+// every hook has to be at a function start in the code section and its jump must not run into the
+// next function. Only depends on the standard library so it builds on any platform, for example:
+//   g++ -std=c++17 -O2 src/openhedz-hookcheck/*.cpp -o hookcheck
+//   ./hookcheck bin/Hedz.exe src/openhedz
+#include "peimage.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace openhedz::hookcheck;
+
+namespace
+{
+    // Size of the jmp rel32 written by hooks::applyHooks.
+    constexpr uint32_t kJmpSize = 5;
+
+    struct Hook
+    {
+        uint32_t address;
+        std::string name;
+        std::string location;
+    };
+
+    struct Function
+    {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    void collectHooks(const std::filesystem::path& file, std::vector<Hook>& hooks)
+    {
+        static const std::regex kHookPattern(R"(HOOK_FUNCTION\(\s*(0x[0-9A-Fa-f]+)\s*,\s*(\w+)\s*\))");
+
+        std::ifstream stream(file);
+        std::string line;
+        for (int lineNo = 1; std::getline(stream, line); ++lineNo)
+        {
+            std::smatch match;
+            if (!std::regex_search(line, match, kHookPattern))
+                continue;
+
+            Hook hook{};
+            hook.address = static_cast<uint32_t>(std::stoul(match[1].str(), nullptr, 16));
+            hook.name = match[2].str();
+            hook.location = file.generic_string() + ":" + std::to_string(lineNo);
+            hooks.push_back(std::move(hook));
+        }
+    }
+
+    bool collectHooks(const std::filesystem::path& path, std::vector<Hook>& hooks, std::string& error)
+    {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(path, ec))
+        {
+            collectHooks(path, hooks);
+            return true;
+        }
+
+        if (!std::filesystem::is_directory(path, ec))
+        {
+            error = "no such file or directory";
+            return false;
+        }
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+        {
+            const auto ext = entry.path().extension();
+            if (entry.is_regular_file() && (ext == ".cpp" || ext == ".hpp"))
+                collectHooks(entry.path(), hooks);
+        }
+        return true;
+    }
+
+    class CodeView
+    {
+        const Section& _section;
+
+    public:
+        explicit CodeView(const Section& section)
+            : _section(section)
+        {
+        }
+
+        uint32_t begin() const
+        {
+            return _section.va;
+        }
+
+        uint32_t end() const
+        {
+            return _section.va + static_cast<uint32_t>(_section.dataSize);
+        }
+
+        bool contains(uint32_t addr) const
+        {
+            return addr >= begin() && addr < end();
+        }
+
+        uint8_t at(uint32_t addr) const
+        {
+            return contains(addr) ? _section.data[addr - _section.va] : 0;
+        }
+
+        int32_t rel32At(uint32_t addr) const
+        {
+            int32_t v = 0;
+            if (contains(addr) && contains(addr + 3))
+                std::memcpy(&v, _section.data + (addr - _section.va), sizeof(v));
+            return v;
+        }
+
+        static bool isPadding(uint8_t b)
+        {
+            return b == 0x90 || b == 0xCC;
+        }
+
+        bool hasPrologue(uint32_t addr) const
+        {
+            // push ebp; mov ebp, esp in both encodings.
+            return at(addr) == 0x55
+                && ((at(addr + 1) == 0x8B && at(addr + 2) == 0xEC) || (at(addr + 1) == 0x89 && at(addr + 2) == 0xE5));
+        }
+
+        // The previous function ended with a ret or jmp, optionally followed by alignment padding.
+        bool followsFunctionEnd(uint32_t addr) const
+        {
+            if (addr == begin())
+                return true;
+
+            uint32_t pos = addr - 1;
+            const bool padded = isPadding(at(pos));
+            while (pos > begin() && isPadding(at(pos)))
+            {
+                pos--;
+            }
+
+            if (at(pos) == 0xC3)
+                return true;
+            if (pos >= begin() + 2 && at(pos - 2) == 0xC2)
+                return true;
+            // Only trust jumps when padding follows, a bare jump is common inside functions.
+            if (padded && pos >= begin() + 4 && at(pos - 4) == 0xE9)
+                return true;
+            if (padded && pos >= begin() + 1 && at(pos - 1) == 0xEB)
+                return true;
+            return false;
+        }
+
+        bool looksLikeStart(uint32_t addr) const
+        {
+            return hasPrologue(addr) || (!isPadding(at(addr)) && followsFunctionEnd(addr));
+        }
+    };
+
+    // There are no symbols or relocations, function starts are the targets of direct calls plus the
+    // aligned addresses after the end of a function. Both are filtered by what a start looks like to
+    // drop call opcodes that are really part of other instructions or data.
+    std::vector<Function> findFunctions(const CodeView& code, uint32_t entryPoint)
+    {
+        std::vector<uint32_t> starts;
+        if (code.contains(entryPoint))
+            starts.push_back(entryPoint);
+
+        for (uint32_t addr = code.begin(); addr + kJmpSize <= code.end(); ++addr)
+        {
+            if (code.at(addr) != 0xE8)
+                continue;
+
+            const uint32_t target = addr + kJmpSize + static_cast<uint32_t>(code.rel32At(addr + 1));
+            if (code.contains(target) && code.looksLikeStart(target))
+                starts.push_back(target);
+        }
+
+        for (uint32_t addr = (code.begin() + 15) & ~15u; addr < code.end(); addr += 16)
+        {
+            if (CodeView::isPadding(code.at(addr - 1)) && code.followsFunctionEnd(addr))
+                starts.push_back(addr);
+        }
+
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+        std::vector<Function> functions;
+        functions.reserve(starts.size());
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            const uint32_t end = i + 1 < starts.size() ? starts[i + 1] : code.end();
+            functions.push_back({ starts[i], end });
+        }
+        return functions;
+    }
+
+    int printUsage()
+    {
+        printf("Usage: hookcheck <Hedz.exe> <source file or directory>...\n");
+        printf("Reports hooks that are not at a function start or whose jump overlaps the next function.\n");
+        return EXIT_FAILURE;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return printUsage();
+
+    PeImage image;
+    std::string error;
+    if (!image.load(argv[1], error))
+    {
+        fprintf(stderr, "Unable to load %s: %s\n", argv[1], error.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const Section* section = image.getCodeSection();
+    if (section == nullptr || section->data == nullptr)
+    {
+        fprintf(stderr, "%s has no code section\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Hook> hooks;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!collectHooks(argv[i], hooks, error))
+        {
+            fprintf(stderr, "Unable to read %s: %s\n", argv[i], error.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::sort(hooks.begin(), hooks.end(), [](const Hook& a, const Hook& b) { return a.address < b.address; });
+
+    const CodeView code(*section);
+    const std::vector<Function> functions = findFunctions(code, image.getEntryPoint());
+
+    size_t errors = 0;
+    uint64_t coveredBytes = 0;
+    for (size_t i = 0; i < hooks.size(); ++i)
+    {
+        const Hook& hook = hooks[i];
+
+        const char* problem = nullptr;
+        auto it = std::lower_bound(
+            functions.begin(), functions.end(), hook.address, [](const Function& f, uint32_t addr) { return f.start < addr; });
+        auto next = std::upper_bound(
+            functions.begin(), functions.end(), hook.address, [](uint32_t addr, const Function& f) { return addr < f.start; });
+
+        if (!code.contains(hook.address))
+        {
+            problem = "outside of the code section";
+        }
+        else if (i > 0 && hooks[i - 1].address == hook.address)
+        {
+            problem = "hooked twice";
+        }
+        else if (i > 0 && hooks[i - 1].address + kJmpSize > hook.address)
+        {
+            problem = "overlaps the jump of the previous hook";
+        }
+        else if ((it == functions.end() || it->start != hook.address) && !code.looksLikeStart(hook.address))
+        {
+            problem = "not at a function start";
+        }
+        else if (next != functions.end() && next->start < hook.address + kJmpSize)
+        {
+            problem = "too close to the next function for the jump";
+        }
+
+        if (problem != nullptr)
+        {
+            printf("error: %s: %s at 0x%08X, %s\n", hook.location.c_str(), hook.name.c_str(), hook.address, problem);
+            errors++;
+            continue;
+        }
+
+        if (it != functions.end() && it->start == hook.address)
+            coveredBytes += it->end - it->start;
+    }
+
+    const uint32_t codeSize = code.end() - code.begin();
+    printf(
+        "%zu hooks, %zu functions found in %s (%u bytes)\n", hooks.size(), functions.size(), section->name.c_str(), codeSize);
+    printf(
+        "Hooks cover %.2f%% of the code, %.2f%% of the functions\n", codeSize != 0 ? 100.0 * coveredBytes / codeSize : 0.0,
+        functions.empty() ? 0.0 : 100.0 * (hooks.size() - errors) / functions.size());
+
+    if (errors != 0)
+    {
+        printf("%zu invalid hooks\n", errors);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include "peimage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace openhedz::hookcheck
+{
+    static constexpr uint16_t kMachineI386 = 0x014C;
+    static constexpr uint16_t kOptionalMagicPe32 = 0x010B;
+    static constexpr uint32_t kSectionCode = 0x00000020;
+    static constexpr uint32_t kSectionExecute = 0x20000000;
+    static constexpr size_t kSectionHeaderSize = 40;
+
+    template<typename T> static bool readAt(const std::vector<uint8_t>& data, size_t offset, T& v)
+    {
+        if (offset > data.size() || data.size() - offset < sizeof(T))
+            return false;
+        std::memcpy(&v, data.data() + offset, sizeof(T));
+        return true;
+    }
+
+    bool Section::isCode() const
+    {
+        return (characteristics & (kSectionCode | kSectionExecute)) != 0;
+    }
+
+    bool PeImage::load(const std::string& path, std::string& error)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            error = "unable to open file";
+            return false;
+        }
+        _file.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        uint16_t dosMagic = 0;
+        uint32_t peOffset = 0;
+        if (!readAt(_file, 0, dosMagic) || dosMagic != 0x5A4D || !readAt(_file, 0x3C, peOffset))
+        {
+            error = "missing DOS header";
+            return false;
+        }
+
+        uint32_t peMagic = 0;
+        if (!readAt(_file, peOffset, peMagic) || peMagic != 0x00004550)
+        {
+            error = "missing PE header";
+            return false;
+        }
+
+        const size_t coffOffset = peOffset + 4;
+        uint16_t machine = 0;
+        uint16_t sectionCount = 0;
+        uint16_t optionalSize = 0;
+        if (!readAt(_file, coffOffset, machine) || !readAt(_file, coffOffset + 2, sectionCount)
+            || !readAt(_file, coffOffset + 16, optionalSize))
+        {
+            error = "truncated COFF header";
+            return false;
+        }
+
+        const size_t optionalOffset = coffOffset + 20;
+        uint16_t optionalMagic = 0;
+        if (machine != kMachineI386 || !readAt(_file, optionalOffset, optionalMagic) || optionalMagic != kOptionalMagicPe32)
+        {
+            error = "not a 32-bit x86 image";
+            return false;
+        }
+
+        uint32_t entryRva = 0;
+        if (!readAt(_file, optionalOffset + 16, entryRva) || !readAt(_file, optionalOffset + 28, _imageBase))
+        {
+            error = "truncated optional header";
+            return false;
+        }
+        _entryPoint = _imageBase + entryRva;
+
+        const size_t sectionsOffset = optionalOffset + optionalSize;
+        for (uint16_t i = 0; i < sectionCount; ++i)
+        {
+            const size_t offset = sectionsOffset + i * kSectionHeaderSize;
+
+            char name[9]{};
+            uint32_t virtualSize = 0;
+            uint32_t rva = 0;
+            uint32_t rawSize = 0;
+            uint32_t rawOffset = 0;
+            Section section{};
+            if (offset + kSectionHeaderSize > _file.size() || !readAt(_file, offset + 8, virtualSize)
+                || !readAt(_file, offset + 12, rva) || !readAt(_file, offset + 16, rawSize)
+                || !readAt(_file, offset + 20, rawOffset) || !readAt(_file, offset + 36, section.characteristics))
+            {
+                error = "truncated section table";
+                return false;
+            }
+            std::memcpy(name, _file.data() + offset, 8);
+
+            section.name = name;
+            section.va = _imageBase + rva;
+            section.size = virtualSize != 0 ? virtualSize : rawSize;
+
+            if (rawOffset < _file.size())
+            {
+                section.data = _file.data() + rawOffset;
+                section.dataSize = std::min<size_t>({ rawSize, section.size, _file.size() - rawOffset });
+            }
+            _sections.push_back(section);
+        }
+
+        return true;
+    }
+
+    const Section* PeImage::findSection(uint32_t addr) const
+    {
+        for (const auto& section : _sections)
+        {
+            if (section.contains(addr))
+                return &section;
+        }
+        return nullptr;
+    }
+
+    const Section* PeImage::getCodeSection() const
+    {
+        const Section* section = findSection(_entryPoint);
+        if (section != nullptr && section->isCode())
+            return section;
+
+        for (const auto& candidate : _sections)
+        {
+            if (candidate.isCode())
+                return &candidate;
+        }
+        return nullptr;
+    }
+
+} // namespace openhedz::hookcheck
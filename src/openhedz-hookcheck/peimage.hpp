@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openhedz::hookcheck
+{
+    struct Section
+    {
+        std::string name;
+        uint32_t va;
+        uint32_t size;
+        uint32_t characteristics;
+        // Raw data of the section, shorter than size when the tail is zero filled.
+        const uint8_t* data;
+        size_t dataSize;
+
+        bool contains(uint32_t addr) const
+        {
+            return addr >= va && addr - va < size;
+        }
+
+        bool isCode() const;
+    };
+
+    // Minimal reader for 32-bit PE images, addresses are absolute VAs using the preferred image base.
+    class PeImage
+    {
+        std::vector<uint8_t> _file;
+        std::vector<Section> _sections;
+        uint32_t _imageBase = 0;
+        uint32_t _entryPoint = 0;
+
+    public:
+        bool load(const std::string& path, std::string& error);
+
+        uint32_t getImageBase() const
+        {
+            return _imageBase;
+        }
+
+        uint32_t getEntryPoint() const
+        {
+            return _entryPoint;
+        }
+
+        const std::vector<Section>& getSections() const
+        {
+            return _sections;
+        }
+
+        const Section* findSection(uint32_t addr) const;
+
+        // The section holding the entry point, falls back to the first executable one.
+        const Section* getCodeSection() const;
+    };
+
+} // namespace openhedz::hookcheck
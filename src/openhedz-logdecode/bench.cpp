@@ -0,0 +1,113 @@
+#include "bench.hpp"
+
+#include <openhedz/core/diagnostics/logformat.hpp>
+#include <openhedz/core/diagnostics/logtimestamp.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace openhedz::diagnostics::logging;
+
+namespace openhedz::logdecode
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps the optimizer from dropping the formatted output.
+    static volatile size_t gSink = 0;
+
+    template<typename TFn> static double measure(TFn&& fn)
+    {
+        constexpr double kMinSeconds = 0.25;
+
+        size_t iterations = 0;
+        double elapsed = 0.0;
+        const auto start = Clock::now();
+        do
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                fn(static_cast<uint32_t>(iterations + i));
+            }
+            iterations += 1000;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < kMinSeconds);
+
+        return elapsed * 1e9 / static_cast<double>(iterations);
+    }
+
+    template<typename TFormat, typename... Args> static void runCase(const char* name, TFormat fmt, const Args&... args)
+    {
+        const double printfNs = measure([&](uint32_t) {
+            char buffer[256];
+            gSink += static_cast<size_t>(snprintf(buffer, sizeof(buffer), fmt.c_str(), args...));
+        });
+
+        // Same paths as ILogHandle::formatMsg.
+        const double segmentNs = measure([&](uint32_t) {
+            if constexpr (TFormat::IsLiteral)
+            {
+                gSink += fmt.c_str()[0];
+            }
+            else
+            {
+                Detail::FormatBuffer buffer;
+                TFormat::format(buffer, args...);
+                gSink += buffer.size();
+            }
+        });
+
+        printf("%-12s %10.1f ns %10.1f ns %8.2fx\n", name, printfNs, segmentNs, printfNs / segmentNs);
+    }
+
+    // Elapsed milliseconds for the iteration, messagesPerMs messages share a millisecond.
+    static void runTimestampCase(const char* name, uint32_t messagesPerMs)
+    {
+        const double printfNs = measure([&](uint32_t i) {
+            const uint64_t elapsed = i / messagesPerMs;
+            const uint64_t secs = elapsed / 1000;
+            const uint64_t ms = elapsed - (secs * 1000);
+            const uint64_t mins = secs / 60;
+            const uint64_t hrs = (mins / 60);
+
+            char timestamp[32];
+            gSink += static_cast<size_t>(snprintf(
+                timestamp, sizeof(timestamp), "[%02llu:%02llu:%02llu:%03llu] ", static_cast<unsigned long long>(hrs),
+                static_cast<unsigned long long>(mins % 60), static_cast<unsigned long long>(secs % 60),
+                static_cast<unsigned long long>(ms)));
+        });
+
+        TimestampCache cache;
+        const double cachedNs = measure([&](uint32_t i) {
+            gSink += cache.format(i / messagesPerMs)[10];
+        });
+
+        printf("%-12s %10.1f ns %10.1f ns %8.2fx\n", name, printfNs, cachedNs, printfNs / cachedNs);
+    }
+
+    int runBenchmarks()
+    {
+        printf("%-12s %13s %13s %9s\n", "case", "snprintf", "segments", "speedup");
+
+        runCase("literal", LOG_FMT("Waiting for debugger\n"));
+        runCase(
+            "hook", LOG_FMT("Hook \"%s\" applied at %p\n"), "decompressText", reinterpret_cast<void*>(0x00424A20));
+        runCase(
+            "textcache", LOG_FMT("Text cache: %llu hits, %llu misses, %llu evictions, %zu entries, %zu bytes\n"),
+            12345ull, 678ull, 9ull, size_t(42), size_t(4194304));
+        runCase(
+            "assertion", LOG_FMT("%s:%d Assertion failure (%s %s %s) - %s\n"), "src/openhedz/game.cpp", 170, "1", "==",
+            "2", "Unexpected value");
+        runCase("padded", LOG_FMT("%08X %5d %.3f\n"), 0xDEADu, 42, 3.14159);
+
+        printf("\n%-12s %13s %13s %9s\n", "timestamp", "snprintf", "cached", "speedup");
+
+        runTimestampCase("16 per ms", 16);
+        runTimestampCase("1 per ms", 1);
+
+        return gSink != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+} // namespace openhedz::logdecode
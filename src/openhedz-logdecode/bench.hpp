@@ -0,0 +1,9 @@
+#pragma once
+
+namespace openhedz::logdecode
+{
+    // Compares snprintf against the compile time parsed log formats on messages modelled after the
+    // ones the game logs, and the cached timestamp prefix against formatting it every time.
+    int runBenchmarks();
+
+} // namespace openhedz::logdecode
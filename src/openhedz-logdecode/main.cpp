@@ -0,0 +1,420 @@
+// Offline decoder for binary logs written with logging::Options::Binary, formats the recorded
+// messages back into the text log layout. Only depends on the portable logging headers so it builds on any platform.
+#include "bench.hpp"
+
+#include <openhedz/core/diagnostics/logbinaryformat.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace openhedz::diagnostics::logging;
+
+namespace
+{
+    struct Arg
+    {
+        uint8_t type;
+        uint64_t value;
+        std::string str;
+    };
+
+    struct Message
+    {
+        uint64_t timestamp;
+        uint32_t threadId;
+        uint8_t type;
+        uint64_t formatId;
+        std::vector<Arg> args;
+    };
+
+    class Reader
+    {
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos = 0;
+
+    public:
+        Reader(const uint8_t* data, size_t size)
+            : _data(data)
+            , _size(size)
+        {
+        }
+
+        bool atEnd() const
+        {
+            return _pos >= _size;
+        }
+
+        template<typename T> bool read(T& v)
+        {
+            if (_size - _pos < sizeof(T))
+                return false;
+            std::memcpy(&v, _data + _pos, sizeof(T));
+            _pos += sizeof(T);
+            return true;
+        }
+
+        bool readString(std::string& str, uint32_t len)
+        {
+            if (_size - _pos < len)
+                return false;
+            str.assign(reinterpret_cast<const char*>(_data + _pos), len);
+            _pos += len;
+            return true;
+        }
+
+        bool skip(size_t len)
+        {
+            if (_size - _pos < len)
+                return false;
+            _pos += len;
+            return true;
+        }
+
+        const uint8_t* current() const
+        {
+            return _data + _pos;
+        }
+    };
+
+    bool readArg(Reader& reader, Arg& arg)
+    {
+        if (!reader.read(arg.type))
+            return false;
+
+        if (arg.type == binary::kArgString)
+        {
+            uint32_t len = 0;
+            return reader.read(len) && reader.readString(arg.str, len);
+        }
+        return reader.read(arg.value);
+    }
+
+    bool readChunk(
+        Reader& reader, uint32_t threadId, std::unordered_map<uint64_t, std::string>& formats,
+        std::vector<Message>& messages)
+    {
+        while (!reader.atEnd())
+        {
+            uint8_t tag = 0;
+            reader.read(tag);
+
+            if (tag == binary::kRecordFormat)
+            {
+                uint64_t id = 0;
+                uint32_t len = 0;
+                std::string fmt;
+                if (!reader.read(id) || !reader.read(len) || !reader.readString(fmt, len))
+                    return false;
+                formats[id] = std::move(fmt);
+            }
+            else if (tag == binary::kRecordMessage)
+            {
+                Message msg{};
+                msg.threadId = threadId;
+
+                uint8_t argCount = 0;
+                if (!reader.read(msg.type) || !reader.read(msg.timestamp) || !reader.read(msg.formatId)
+                    || !reader.read(argCount))
+                    return false;
+
+                msg.args.resize(argCount);
+                for (auto& arg : msg.args)
+                {
+                    if (!readArg(reader, arg))
+                        return false;
+                }
+                messages.push_back(std::move(msg));
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename T> void appendFormat(std::string& out, const std::string& spec, T value)
+    {
+        char buffer[512];
+        const int len = snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+        if (len < 0)
+            return;
+
+        if (static_cast<size_t>(len) < sizeof(buffer))
+        {
+            out.append(buffer, len);
+            return;
+        }
+
+        std::vector<char> large(static_cast<size_t>(len) + 1);
+        snprintf(large.data(), large.size(), spec.c_str(), value);
+        out.append(large.data(), len);
+    }
+
+    // Applies the printf conversions of the format string to the recorded arguments.
+    std::string formatMessage(const std::string& fmt, const std::vector<Arg>& args)
+    {
+        std::string out;
+        size_t argIndex = 0;
+
+        auto nextInt = [&]() -> int {
+            if (argIndex >= args.size())
+                return 0;
+            return static_cast<int>(args[argIndex++].value);
+        };
+
+        for (size_t i = 0; i < fmt.size(); ++i)
+        {
+            if (fmt[i] != '%')
+            {
+                out += fmt[i];
+                continue;
+            }
+
+            if (i + 1 < fmt.size() && fmt[i + 1] == '%')
+            {
+                out += '%';
+                ++i;
+                continue;
+            }
+
+            // Flags, width and precision are kept, length modifiers are replaced to match the stored type.
+            std::string spec = "%";
+            size_t j = i + 1;
+            while (j < fmt.size() && strchr("-+ #0", fmt[j]) != nullptr)
+            {
+                spec += fmt[j++];
+            }
+            while (j < fmt.size() && (isdigit(static_cast<unsigned char>(fmt[j])) || fmt[j] == '*' || fmt[j] == '.'))
+            {
+                if (fmt[j] == '*')
+                    spec += std::to_string(nextInt());
+                else
+                    spec += fmt[j];
+                ++j;
+            }
+            // 'h' and 'hh' truncate the argument, the record stores it widened.
+            int shortCount = 0;
+            while (j < fmt.size() && strchr("hlLqjzt", fmt[j]) != nullptr)
+            {
+                if (fmt[j] == 'h')
+                    shortCount++;
+                ++j;
+            }
+            if (j < fmt.size() && fmt[j] == 'I')
+            {
+                // MSVC I32/I64 length modifiers.
+                ++j;
+                if (j + 1 < fmt.size() && ((fmt[j] == '3' && fmt[j + 1] == '2') || (fmt[j] == '6' && fmt[j + 1] == '4')))
+                    j += 2;
+            }
+            if (j >= fmt.size())
+            {
+                out.append(fmt, i, fmt.npos);
+                break;
+            }
+
+            const char conv = fmt[j];
+            i = j;
+
+            if (argIndex >= args.size())
+            {
+                out += "<missing>";
+                continue;
+            }
+
+            const Arg& arg = args[argIndex++];
+            switch (conv)
+            {
+                case 'd':
+                case 'i':
+                {
+                    long long value = static_cast<long long>(arg.value);
+                    if (shortCount == 1)
+                        value = static_cast<int16_t>(value);
+                    else if (shortCount >= 2)
+                        value = static_cast<int8_t>(value);
+                    appendFormat(out, spec + "lld", value);
+                    break;
+                }
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                {
+                    unsigned long long value = static_cast<unsigned long long>(arg.value);
+                    if (shortCount == 1)
+                        value = static_cast<uint16_t>(value);
+                    else if (shortCount >= 2)
+                        value = static_cast<uint8_t>(value);
+                    appendFormat(out, spec + "ll" + conv, value);
+                    break;
+                }
+                case 'c':
+                    appendFormat(out, spec + "c", static_cast<int>(arg.value));
+                    break;
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                {
+                    double value = 0.0;
+                    if (arg.type == binary::kArgDouble)
+                        std::memcpy(&value, &arg.value, sizeof(value));
+                    appendFormat(out, spec + conv, value);
+                    break;
+                }
+                case 's':
+                case 'S':
+                    if (arg.type == binary::kArgString)
+                        appendFormat(out, spec + "s", arg.str.c_str());
+                    else
+                        appendFormat(out, spec + "s", "<invalid>");
+                    break;
+                case 'p':
+                    // Matches the MSVC output for 32-bit pointers.
+                    appendFormat(out, spec == "%" ? "%08llX" : spec + "llX", static_cast<unsigned long long>(arg.value));
+                    break;
+                default:
+                    out.append(fmt, i, 1);
+                    break;
+            }
+        }
+        return out;
+    }
+
+    bool readFile(const char* path, std::vector<uint8_t>& data)
+    {
+        std::ifstream fs(path, std::ios::binary);
+        if (!fs)
+            return false;
+
+        data.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    int printUsage()
+    {
+        fprintf(
+            stderr, "Usage:\n"
+                    "  logdecode <input.blog> [output] [--threads]\n"
+                    "  logdecode bench\n");
+        return EXIT_FAILURE;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+        return printUsage();
+
+    if (strcmp(argv[1], "bench") == 0)
+        return openhedz::logdecode::runBenchmarks();
+
+    const char* outputPath = nullptr;
+    bool showThreads = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0)
+            showThreads = true;
+        else if (outputPath == nullptr)
+            outputPath = argv[i];
+        else
+            return printUsage();
+    }
+
+    std::vector<uint8_t> data;
+    if (!readFile(argv[1], data))
+    {
+        fprintf(stderr, "Unable to read %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (data.size() < sizeof(binary::kFileMagic) || memcmp(data.data(), binary::kFileMagic, sizeof(binary::kFileMagic)) != 0)
+    {
+        fprintf(stderr, "%s is not a binary log\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::unordered_map<uint64_t, std::string> formats;
+    std::vector<Message> messages;
+
+    Reader reader(data.data() + sizeof(binary::kFileMagic), data.size() - sizeof(binary::kFileMagic));
+    while (!reader.atEnd())
+    {
+        uint32_t header[2] = {};
+        if (!reader.read(header))
+        {
+            fprintf(stderr, "Truncated chunk header, ignoring the rest of the file\n");
+            break;
+        }
+
+        const uint8_t* chunkData = reader.current();
+        if (!reader.skip(header[1]))
+        {
+            fprintf(stderr, "Truncated chunk, ignoring the rest of the file\n");
+            break;
+        }
+
+        Reader chunk(chunkData, header[1]);
+        if (!readChunk(chunk, header[0], formats, messages))
+        {
+            fprintf(stderr, "Malformed record in chunk of thread %u\n", header[0]);
+        }
+    }
+
+    // Chunks of different threads are written as they fill up, restore the global order.
+    std::stable_sort(messages.begin(), messages.end(), [](const Message& a, const Message& b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    FILE* out = stdout;
+    if (outputPath != nullptr)
+    {
+        out = fopen(outputPath, "wt");
+        if (out == nullptr)
+        {
+            fprintf(stderr, "Unable to write %s\n", outputPath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (const auto& msg : messages)
+    {
+        auto it = formats.find(msg.formatId);
+        const std::string text = it != formats.end() ? formatMessage(it->second, msg.args) : "<unknown format>\n";
+
+        const uint64_t ms = msg.timestamp / 1000;
+        const uint64_t secs = ms / 1000;
+        const uint64_t mins = secs / 60;
+        const uint64_t hrs = mins / 60;
+
+        fprintf(
+            out, "[%02llu:%02llu:%02llu:%03llu] ", static_cast<unsigned long long>(hrs),
+            static_cast<unsigned long long>(mins % 60), static_cast<unsigned long long>(secs % 60),
+            static_cast<unsigned long long>(ms % 1000));
+        if (showThreads)
+            fprintf(out, "[%5u] ", msg.threadId);
+        fputs(text.c_str(), out);
+    }
+
+    if (out != stdout)
+        fclose(out);
+
+    fprintf(stderr, "%zu messages, %zu formats\n", messages.size(), formats.size());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include "allocstats.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // The header keeps the size for the matching delete. Atomic as the batch benchmark allocates from
+    // several threads.
+    constexpr size_t kAllocHeaderSize = alignof(std::max_align_t);
+
+    std::atomic<size_t> gAllocCount{ 0 };
+    std::atomic<size_t> gLiveBytes{ 0 };
+    std::atomic<size_t> gPeakBytes{ 0 };
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    auto* p = static_cast<uint8_t*>(std::malloc(size + kAllocHeaderSize));
+    if (p == nullptr)
+        throw std::bad_alloc();
+
+    *reinterpret_cast<size_t*>(p) = size;
+
+    gAllocCount++;
+    const size_t live = gLiveBytes += size;
+    size_t peak = gPeakBytes.load();
+    while (live > peak && !gPeakBytes.compare_exchange_weak(peak, live))
+    {
+    }
+
+    return p + kAllocHeaderSize;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    auto* p = static_cast<uint8_t*>(ptr) - kAllocHeaderSize;
+    gLiveBytes -= *reinterpret_cast<size_t*>(p);
+    std::free(p);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+namespace openhedz::textpack
+{
+    size_t getAllocCount()
+    {
+        return gAllocCount;
+    }
+
+    size_t getLiveBytes()
+    {
+        return gLiveBytes;
+    }
+
+    size_t getPeakBytes()
+    {
+        return gPeakBytes;
+    }
+
+    void resetPeakBytes()
+    {
+        gPeakBytes = gLiveBytes.load();
+    }
+
+} // namespace openhedz::textpack
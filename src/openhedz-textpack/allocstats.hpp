@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+namespace openhedz::textpack
+{
+    // The tool replaces the global operator new and delete to count allocations, in a separate
+    // translation unit so the compiler can not inline them into the code that is measured.
+    size_t getAllocCount();
+    size_t getLiveBytes();
+    size_t getPeakBytes();
+
+    // Restarts the peak at the current live bytes.
+    void resetPeakBytes();
+
+} // namespace openhedz::textpack
@@ -0,0 +1,271 @@
+#include "bench.hpp"
+
+#include "allocstats.hpp"
+#include "referencedecoder.hpp"
+
+#include <openhedz/utils/textcache.hpp>
+#include <openhedz/utils/textcompress.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <utility>
+
+namespace openhedz::textpack
+{
+    using Clock = std::chrono::steady_clock;
+    using DecodeFn = std::vector<uint8_t> (*)(const uint8_t*);
+
+    struct Corpus
+    {
+        std::string name;
+        std::vector<uint8_t> compressed;
+        size_t uncompressedSize;
+    };
+
+    struct BenchResult
+    {
+        double mbPerSec;
+        double nsPerSymbol;
+        double allocsPerCall;
+        size_t peakBytes;
+    };
+
+    // Minimum time spent per corpus and decoder, small corpora are repeated until it is reached.
+    constexpr double kMinBenchSeconds = 0.5;
+
+    static Corpus makeCorpus(std::string name, const std::vector<uint8_t>& text)
+    {
+        return { std::move(name), compressText(text.data(), text.size()), text.size() };
+    }
+
+    template<typename TGen> static std::vector<uint8_t> generate(size_t size, TGen&& gen)
+    {
+        std::vector<uint8_t> res(size);
+        for (auto& c : res)
+        {
+            c = gen();
+        }
+        return res;
+    }
+
+    static void addSyntheticCorpora(std::vector<Corpus>& corpora)
+    {
+        static const char* const kWords[] = {
+            "the ", "head ", "zone ", "extreme ", "destruction ", "collect ", "heads ", "and ", "use ", "their ",
+            "powers ", "to ", "win\n", "Player ", "1 ", "2 ", "Press ", "FIRE ", "start. ", "Options ",
+        };
+
+        for (const size_t size : { size_t{ 4 } * 1024, size_t{ 1024 } * 1024 })
+        {
+            const std::string suffix = size < 1024 * 1024 ? "-4k" : "-1m";
+
+            std::mt19937 rng(1);
+            corpora.push_back(makeCorpus("uniform16" + suffix, generate(size, [&]() { return uint8_t('a' + rng() % 16); })));
+            corpora.push_back(makeCorpus("uniform256" + suffix, generate(size, [&]() { return uint8_t(rng()); })));
+
+            // Geometric distribution, produces codes from 1 bit up to well past the root lookup table.
+            std::geometric_distribution<int> geometric(0.4);
+            corpora.push_back(makeCorpus(
+                "skewed" + suffix, generate(size, [&]() { return uint8_t('A' + std::min(geometric(rng), 40)); })));
+
+            std::vector<uint8_t> text;
+            while (text.size() < size)
+            {
+                const char* word = kWords[rng() % std::size(kWords)];
+                text.insert(text.end(), word, word + strlen(word));
+            }
+            text.resize(size);
+            corpora.push_back(makeCorpus("text" + suffix, text));
+        }
+    }
+
+    static bool addFileCorpus(std::vector<Corpus>& corpora, const std::string& path)
+    {
+        std::ifstream fs(path, std::ios::binary);
+        if (!fs)
+            return false;
+
+        std::vector<uint8_t> data(std::istreambuf_iterator<char>(fs), {});
+
+        const bool isContainer = path.size() > 3 && path.compare(path.size() - 3, 3, ".hz") == 0;
+        if (!isContainer)
+        {
+            corpora.push_back(makeCorpus(path, data));
+            return true;
+        }
+
+        if (data.size() < 6)
+            return false;
+
+        const size_t uncompressedSize = *(uint32_t*)(data.data() + 2);
+        corpora.push_back({ path, std::move(data), uncompressedSize });
+        return true;
+    }
+
+    static BenchResult runDecoder(const Corpus& corpus, DecodeFn decode)
+    {
+        // Warm up, also measures allocations and peak memory of a single call.
+        const size_t allocsBefore = getAllocCount();
+        const size_t liveBefore = getLiveBytes();
+        resetPeakBytes();
+        {
+            auto res = decode(corpus.compressed.data());
+        }
+        const size_t allocs = getAllocCount() - allocsBefore;
+        const size_t peakBytes = getPeakBytes() - liveBefore;
+
+        size_t iterations = 0;
+        const auto start = Clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            auto res = decode(corpus.compressed.data());
+            ++iterations;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < kMinBenchSeconds);
+
+        const double symbols = static_cast<double>(corpus.uncompressedSize) * iterations;
+
+        BenchResult res{};
+        res.mbPerSec = symbols / elapsed / (1024.0 * 1024.0);
+        res.nsPerSymbol = elapsed * 1e9 / symbols;
+        res.allocsPerCall = static_cast<double>(allocs);
+        res.peakBytes = peakBytes;
+        return res;
+    }
+
+    // Stands in for the text resources loaded at startup, many small blobs and a few large ones.
+    static std::vector<std::vector<uint8_t>> makeBatchBlobs()
+    {
+        constexpr size_t kNumBlobs = 256;
+
+        std::mt19937 rng(2);
+        std::vector<std::vector<uint8_t>> blobs;
+        blobs.reserve(kNumBlobs);
+        for (size_t i = 0; i < kNumBlobs; ++i)
+        {
+            const size_t size = i % 32 == 0 ? 256 * 1024 : 1024 + rng() % (16 * 1024);
+            const auto text = generate(size, [&]() { return uint8_t(' ' + rng() % 64); });
+            blobs.push_back(compressText(text.data(), text.size()));
+        }
+        return blobs;
+    }
+
+    static double timeSeconds(const std::function<void()>& fn)
+    {
+        const auto start = Clock::now();
+        fn();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Compares decoding all blobs one after another with textcache::decompressBatch, the cache stays
+    // disabled so every run decodes everything like a cold start does.
+    static int runBatchBenchmark()
+    {
+        constexpr int kRuns = 5;
+
+        const auto blobs = makeBatchBlobs();
+        std::vector<const uint8_t*> pointers;
+        size_t totalSize = 0;
+        for (const auto& blob : blobs)
+        {
+            pointers.push_back(blob.data());
+            totalSize += *(uint32_t*)(blob.data() + 2);
+        }
+
+        std::vector<textcache::DecodedText> serial;
+        double serialSeconds = 0.0;
+        for (int run = 0; run < kRuns; ++run)
+        {
+            serialSeconds += timeSeconds([&]() {
+                serial.clear();
+                for (const auto* blob : pointers)
+                {
+                    serial.push_back(textcache::decompress(blob));
+                }
+            });
+        }
+        serialSeconds /= kRuns;
+
+        // The first batch also starts the pool.
+        std::vector<textcache::DecodedText> batch;
+        const double firstSeconds = timeSeconds([&]() { batch = textcache::decompressBatch(pointers); });
+
+        double batchSeconds = 0.0;
+        for (int run = 0; run < kRuns; ++run)
+        {
+            batchSeconds += timeSeconds([&]() { batch = textcache::decompressBatch(pointers); });
+        }
+        batchSeconds /= kRuns;
+
+        for (size_t i = 0; i < blobs.size(); ++i)
+        {
+            if (*serial[i] != *batch[i])
+            {
+                fprintf(stderr, "batch: blob %zu differs from the serial result\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+
+        printf(
+            "\nbatch of %zu blobs, %zu bytes, %u hardware threads\n", blobs.size(), totalSize,
+            std::max(std::thread::hardware_concurrency(), 1u));
+        printf("%-24s %10.2f ms\n", "serial", serialSeconds * 1000.0);
+        printf("%-24s %10.2f ms\n", "batch (first, pool start)", firstSeconds * 1000.0);
+        printf("%-24s %10.2f ms %8.2fx\n", "batch", batchSeconds * 1000.0, serialSeconds / batchSeconds);
+        return EXIT_SUCCESS;
+    }
+
+    int runBenchmarks(const std::vector<std::string>& files)
+    {
+        std::vector<Corpus> corpora;
+        addSyntheticCorpora(corpora);
+
+        for (const auto& file : files)
+        {
+            if (!addFileCorpus(corpora, file))
+            {
+                fprintf(stderr, "Unable to read %s\n", file.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+
+        printf(
+            "%-24s %-10s %10s %10s %10s %8s %12s\n", "corpus", "decoder", "size", "MB/s", "ns/symbol", "allocs",
+            "peak bytes");
+
+        for (const auto& corpus : corpora)
+        {
+            if (decodeReference(corpus.compressed.data()) != decodeTable(corpus.compressed.data()))
+            {
+                fprintf(stderr, "%s: decoders disagree\n", corpus.name.c_str());
+                return EXIT_FAILURE;
+            }
+
+            const std::pair<const char*, DecodeFn> decoders[] = {
+                { "reference", decodeReference },
+                { "table", decodeTable },
+            };
+
+            for (const auto& [decoderName, decode] : decoders)
+            {
+                const BenchResult res = runDecoder(corpus, decode);
+                printf(
+                    "%-24s %-10s %10zu %10.1f %10.2f %8.0f %12zu\n", corpus.name.c_str(), decoderName,
+                    corpus.uncompressedSize, res.mbPerSec, res.nsPerSymbol, res.allocsPerCall, res.peakBytes);
+            }
+        }
+
+        return runBatchBenchmark();
+    }
+
+} // namespace openhedz::textpack
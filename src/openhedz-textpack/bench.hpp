@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace openhedz::textpack
+{
+    // Benchmarks the reference and table driven decoders on synthetic corpora and the given files,
+    // files are treated as containers when they end in .hz and as plain text otherwise. Finishes with
+    // serial against batch decompression of a set of blobs.
+    int runBenchmarks(const std::vector<std::string>& files);
+
+} // namespace openhedz::textpack
@@ -0,0 +1,248 @@
+#include "fuzz.hpp"
+
+#include "referencedecoder.hpp"
+
+#include <openhedz/utils/textcompress.hpp>
+#include <openhedz/utils/textdecoder.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace openhedz::textpack
+{
+    static const char* const kFuzzKindNames[] = { "encoded", "incomplete", "overlapping", "arbitrary" };
+
+    constexpr size_t kHeaderSize = 6;
+    constexpr size_t kEntrySize = 6;
+
+    // Every output byte reads at most a code of kMaxCodeLength bits plus the partial bytes around it, tables
+    // that are not produced by the encoder get this much input so neither decoder runs past the blob.
+    constexpr size_t kMaxBytesPerSymbol = kMaxCodeLength / 8 + 2;
+
+    struct FuzzEntry
+    {
+        uint32_t code;
+        uint8_t byte;
+        uint8_t length;
+    };
+
+    static uint16_t getNumEntries(const std::vector<uint8_t>& blob)
+    {
+        uint16_t numEntries = 0;
+        std::memcpy(&numEntries, blob.data(), sizeof(numEntries));
+        return numEntries;
+    }
+
+    static uint32_t getUncompressedSize(const std::vector<uint8_t>& blob)
+    {
+        uint32_t size = 0;
+        std::memcpy(&size, blob.data() + 2, sizeof(size));
+        return size;
+    }
+
+    static std::vector<FuzzEntry> readEntries(const std::vector<uint8_t>& blob)
+    {
+        std::vector<FuzzEntry> entries(getNumEntries(blob));
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const uint8_t* entry = blob.data() + kHeaderSize + i * kEntrySize;
+            std::memcpy(&entries[i].code, entry, sizeof(uint32_t));
+            entries[i].byte = entry[4];
+            entries[i].length = entry[5];
+        }
+        return entries;
+    }
+
+    // Builds a blob from a code table, the payload is random and long enough for any table.
+    template<typename TRng>
+    static std::vector<uint8_t> makeBlob(const std::vector<FuzzEntry>& entries, uint32_t uncompressedSize, TRng& rng)
+    {
+        const auto numEntries = static_cast<uint16_t>(entries.size());
+
+        std::vector<uint8_t> blob(kHeaderSize + entries.size() * kEntrySize);
+        std::memcpy(blob.data(), &numEntries, sizeof(numEntries));
+        std::memcpy(blob.data() + 2, &uncompressedSize, sizeof(uncompressedSize));
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            uint8_t* entry = blob.data() + kHeaderSize + i * kEntrySize;
+            std::memcpy(entry, &entries[i].code, sizeof(uint32_t));
+            entry[4] = entries[i].byte;
+            entry[5] = entries[i].length;
+        }
+
+        const size_t payloadSize = static_cast<size_t>(uncompressedSize) * kMaxBytesPerSymbol + 16;
+        for (size_t i = 0; i < payloadSize; ++i)
+        {
+            blob.push_back(static_cast<uint8_t>(rng()));
+        }
+        return blob;
+    }
+
+    template<typename TRng> static std::vector<uint8_t> makeEncodedBlob(TRng& rng)
+    {
+        const uint32_t alphabet = 1 + rng() % 256;
+        const uint32_t size = 1 + rng() % 4096;
+
+        // Skewed inputs produce long codes that continue past the root lookup table.
+        std::vector<uint8_t> text(size);
+        if (rng() % 2 == 0)
+        {
+            for (auto& c : text)
+                c = static_cast<uint8_t>(rng() % alphabet);
+        }
+        else
+        {
+            std::geometric_distribution<uint32_t> geometric(0.05 + (rng() % 50) / 100.0);
+            for (auto& c : text)
+                c = static_cast<uint8_t>(std::min(geometric(rng), alphabet - 1));
+        }
+        return compressText(text.data(), text.size());
+    }
+
+    // Drops entries from encoder output so parts of the code space lead nowhere.
+    template<typename TRng> static std::vector<uint8_t> makeIncompleteBlob(TRng& rng)
+    {
+        const std::vector<uint8_t> encoded = makeEncodedBlob(rng);
+        std::vector<FuzzEntry> entries = readEntries(encoded);
+
+        std::shuffle(entries.begin(), entries.end(), rng);
+        entries.resize(1 + rng() % entries.size());
+
+        return makeBlob(entries, getUncompressedSize(encoded), rng);
+    }
+
+    // Adds entries to encoder output whose codes are prefixes or extensions of existing codes, so
+    // symbols sit on inner nodes of the tree and entries overwrite each other.
+    template<typename TRng> static std::vector<uint8_t> makeOverlappingBlob(TRng& rng)
+    {
+        const std::vector<uint8_t> encoded = makeEncodedBlob(rng);
+        std::vector<FuzzEntry> entries = readEntries(encoded);
+
+        const size_t numAdded = 1 + rng() % 16;
+        for (size_t i = 0; i < numAdded; ++i)
+        {
+            FuzzEntry entry = entries[rng() % entries.size()];
+            entry.byte = static_cast<uint8_t>(rng());
+
+            const uint32_t mode = rng() % 3;
+            if (mode == 0 && entry.length > 1)
+            {
+                const uint32_t cut = 1 + rng() % (entry.length - 1);
+                entry.code >>= cut;
+                entry.length = static_cast<uint8_t>(entry.length - cut);
+            }
+            else if (mode == 1 && entry.length < kMaxCodeLength)
+            {
+                const uint32_t extra = 1 + rng() % (kMaxCodeLength - entry.length);
+                const uint32_t extraBits = static_cast<uint32_t>(rng()) & ((1u << extra) - 1u);
+                entry.code = static_cast<uint32_t>((static_cast<uint64_t>(entry.code) << extra) | extraBits);
+                entry.length = static_cast<uint8_t>(entry.length + extra);
+            }
+
+            entries.insert(entries.begin() + rng() % (entries.size() + 1), entry);
+        }
+
+        return makeBlob(entries, getUncompressedSize(encoded), rng);
+    }
+
+    // Random codes, short ones collide constantly and long ones leave most of the code space empty.
+    template<typename TRng> static std::vector<uint8_t> makeArbitraryBlob(TRng& rng)
+    {
+        const uint32_t maxLength = rng() % 2 == 0 ? 8 : kMaxCodeLength;
+
+        std::vector<FuzzEntry> entries(rng() % 64);
+        for (auto& entry : entries)
+        {
+            entry.code = static_cast<uint32_t>(rng());
+            entry.byte = static_cast<uint8_t>(rng());
+            entry.length = static_cast<uint8_t>(rng() % (maxLength + 1));
+        }
+
+        return makeBlob(entries, 1 + rng() % 2048, rng);
+    }
+
+    // Same as decodeTable but in chunks of random size, covers resuming in the middle of a code.
+    template<typename TRng> static std::vector<uint8_t> decodeChunked(const uint8_t* buf, TRng& rng)
+    {
+        TextDecoder decoder;
+        decoder.begin(buf);
+
+        std::vector<uint8_t> res(decoder.getUncompressedSize());
+        size_t pos = 0;
+        while (!decoder.finished() && pos < res.size())
+        {
+            const size_t chunk = std::min<size_t>(1 + rng() % 97, res.size() - pos);
+            pos += decoder.decodeInto(res.data() + pos, chunk);
+        }
+        res.resize(pos);
+        return res;
+    }
+
+    static void writeFailure(const std::vector<uint8_t>& blob)
+    {
+        std::ofstream fs("fuzz-failure.hz", std::ios::binary);
+        fs.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+    }
+
+    const char* getFuzzKindName(FuzzKind kind)
+    {
+        return kFuzzKindNames[static_cast<size_t>(kind)];
+    }
+
+    std::vector<uint8_t> makeFuzzBlob(FuzzKind kind, std::mt19937& rng)
+    {
+        switch (kind)
+        {
+            case FuzzKind::Encoded:
+                return makeEncodedBlob(rng);
+            case FuzzKind::Incomplete:
+                return makeIncompleteBlob(rng);
+            case FuzzKind::Overlapping:
+                return makeOverlappingBlob(rng);
+            default:
+                return makeArbitraryBlob(rng);
+        }
+    }
+
+    int runFuzz(uint32_t iterations, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+
+        uint32_t counts[static_cast<size_t>(FuzzKind::Count)] = {};
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            const auto kind = static_cast<FuzzKind>(i % static_cast<uint32_t>(FuzzKind::Count));
+            const std::vector<uint8_t> blob = makeFuzzBlob(kind, rng);
+
+            const auto reference = decodeReference(blob.data());
+            const auto table = decodeTable(blob.data());
+            const auto chunked = decodeChunked(blob.data(), rng);
+
+            if (reference != table || reference != chunked)
+            {
+                const auto mismatch = std::mismatch(reference.begin(), reference.end(), table.begin(), table.end());
+                fprintf(
+                    stderr, "Iteration %u (%s, seed %u): decoders differ at byte %zu of %zu, chunked %s\n", i,
+                    getFuzzKindName(kind), seed,
+                    static_cast<size_t>(mismatch.first - reference.begin()), reference.size(),
+                    reference == chunked ? "matches" : "differs");
+                writeFailure(blob);
+                return EXIT_FAILURE;
+            }
+            counts[static_cast<size_t>(kind)]++;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(FuzzKind::Count); ++i)
+        {
+            printf("%-12s %u\n", getFuzzKindName(static_cast<FuzzKind>(i)), counts[i]);
+        }
+        printf("OK\n");
+        return EXIT_SUCCESS;
+    }
+
+} // namespace openhedz::textpack
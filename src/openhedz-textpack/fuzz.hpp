@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace openhedz::textpack
+{
+    enum class FuzzKind
+    {
+        Encoded,
+        Incomplete,
+        Overlapping,
+        Arbitrary,
+        Count,
+    };
+
+    const char* getFuzzKindName(FuzzKind kind);
+
+    // Compressed blob of the given kind, tables that are not produced by the encoder come with enough
+    // payload that decoding never runs past the blob.
+    std::vector<uint8_t> makeFuzzBlob(FuzzKind kind, std::mt19937& rng);
+
+    // Compares the table driven decoder against the reference decoder on randomly generated blobs, both
+    // encoder output and code tables that are incomplete, overlapping or arbitrary. The first blob that
+    // decodes differently is written to fuzz-failure.hz.
+    int runFuzz(uint32_t iterations, uint32_t seed);
+
+} // namespace openhedz::textpack
@@ -0,0 +1,138 @@
+// Offline tool for the compressed text container used by HEDZ, only depends on the portable
+// parts of libopenhedz so it builds on any platform.
+#include "bench.hpp"
+#include "fuzz.hpp"
+#include "referencedecoder.hpp"
+
+#include <openhedz/utils/textcompress.hpp>
+#include <openhedz/utils/textdecoder.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace openhedz;
+using namespace openhedz::textpack;
+
+namespace
+{
+    bool readFile(const char* path, std::vector<uint8_t>& data)
+    {
+        std::ifstream fs(path, std::ios::binary);
+        if (!fs)
+            return false;
+
+        data.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool writeFile(const char* path, const std::vector<uint8_t>& data)
+    {
+        std::ofstream fs(path, std::ios::binary);
+        if (!fs)
+            return false;
+
+        fs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(fs);
+    }
+
+    // Decodes the container with both decoders, returns false if they disagree.
+    bool verifyContainer(const std::vector<uint8_t>& compressed, const std::vector<uint8_t>* expected)
+    {
+        const auto reference = decodeReference(compressed.data());
+        const auto table = decodeTable(compressed.data());
+
+        if (reference != table)
+        {
+            fprintf(stderr, "Table decoder output differs from the reference decoder\n");
+            return false;
+        }
+        if (expected != nullptr && reference != *expected)
+        {
+            fprintf(stderr, "Decoded output differs from the input\n");
+            return false;
+        }
+        return true;
+    }
+
+    int printUsage()
+    {
+        fprintf(
+            stderr, "Usage:\n"
+                    "  textpack compress <input> <output>\n"
+                    "  textpack decompress <input> <output>\n"
+                    "  textpack verify <file> [--compressed]\n"
+                    "  textpack bench [files...]\n"
+                    "  textpack fuzz [iterations] [seed]\n");
+        return EXIT_FAILURE;
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+        return runBenchmarks(std::vector<std::string>(argv + 2, argv + argc));
+
+    if (argc >= 2 && argc <= 4 && strcmp(argv[1], "fuzz") == 0)
+    {
+        const auto iterations = argc >= 3 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 10000u;
+        const auto seed = argc >= 4 ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 1u;
+        return runFuzz(iterations, seed);
+    }
+
+    if (argc < 3)
+        return printUsage();
+
+    const char* command = argv[1];
+
+    std::vector<uint8_t> input;
+    if (!readFile(argv[2], input))
+    {
+        fprintf(stderr, "Unable to read %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(command, "compress") == 0 && argc == 4)
+    {
+        const auto compressed = compressText(input.data(), input.size());
+        if (!verifyContainer(compressed, &input))
+            return EXIT_FAILURE;
+
+        if (!writeFile(argv[3], compressed))
+        {
+            fprintf(stderr, "Unable to write %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+
+        printf("%zu -> %zu bytes\n", input.size(), compressed.size());
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(command, "decompress") == 0 && argc == 4)
+    {
+        if (!writeFile(argv[3], decodeTable(input.data())))
+        {
+            fprintf(stderr, "Unable to write %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(command, "verify") == 0)
+    {
+        // Either an existing container or plain text that is round tripped through the encoder.
+        const bool isCompressed = argc == 4 && strcmp(argv[3], "--compressed") == 0;
+        const bool ok = isCompressed ? verifyContainer(input, nullptr)
+                                     : verifyContainer(compressText(input.data(), input.size()), &input);
+
+        printf("%s\n", ok ? "OK" : "FAILED");
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    return printUsage();
+}
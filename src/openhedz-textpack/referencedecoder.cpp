@@ -0,0 +1,142 @@
+#include "referencedecoder.hpp"
+
+#include <openhedz/utils/textdecoder.hpp>
+
+#if defined(_MSC_VER)
+#    define NOINLINE __declspec(noinline)
+#else
+#    define NOINLINE __attribute__((noinline))
+#endif
+
+namespace openhedz::textpack
+{
+    // Same layout and allocation pattern as the original, every node is a separate allocation.
+    struct ReferenceNode
+    {
+        uint8_t byte;
+        ReferenceNode* nodeLeft;
+        ReferenceNode* nodeRight;
+    };
+
+    // Globals in the original (0x004D7A94, 0x004D7A98, 0x005E448C).
+    struct ReferenceState
+    {
+        uint8_t bitIndex;
+        uint32_t bufIndex;
+        ReferenceNode* node;
+    };
+
+    // 0x00424BC0
+    static void insertReferenceEntry(ReferenceNode* root, const uint8_t* entry)
+    {
+        const uint32_t code = *(uint32_t*)entry;
+
+        ReferenceNode* cur = root;
+        for (uint32_t bit = 0; bit < entry[5]; ++bit)
+        {
+            if (((1u << ((entry[5] - bit - 1) & 31u)) & code) != 0)
+            {
+                if (cur->nodeLeft == nullptr)
+                    cur->nodeLeft = new ReferenceNode{};
+                cur = cur->nodeLeft;
+            }
+            else
+            {
+                if (cur->nodeRight == nullptr)
+                    cur->nodeRight = new ReferenceNode{};
+                cur = cur->nodeRight;
+            }
+        }
+        cur->byte = entry[4];
+    }
+
+    // 0x004249A0
+    static void destroyReferenceNode(ReferenceNode* node)
+    {
+        if (node == nullptr)
+            return;
+
+        destroyReferenceNode(node->nodeLeft);
+        destroyReferenceNode(node->nodeRight);
+        delete node;
+    }
+
+    // 0x00424C50, kept out of line as the original makes a call for every output byte. Returns false when
+    // the input byte ran out in the middle of a code, the caller then calls again.
+    static NOINLINE bool decodeReferenceByte(
+        ReferenceNode* root, const uint8_t* data, ReferenceState& state, uint8_t& outByte)
+    {
+        const uint8_t curByte = data[state.bufIndex];
+
+        bool found = false;
+        while (!found && state.bitIndex != 8)
+        {
+            const bool isSet = ((0x80u >> state.bitIndex) & curByte) != 0;
+            ReferenceNode* next = isSet ? state.node->nodeLeft : state.node->nodeRight;
+            if (next == nullptr)
+            {
+                found = true;
+                break;
+            }
+            state.node = next;
+            ++state.bitIndex;
+        }
+
+        if (found)
+        {
+            outByte = state.node->byte;
+            state.node = root;
+            return true;
+        }
+
+        state.bitIndex = 0;
+        ++state.bufIndex;
+
+        if (state.node->nodeLeft != nullptr || state.node->nodeRight != nullptr)
+            return false;
+
+        outByte = state.node->byte;
+        state.node = root;
+        return true;
+    }
+
+    std::vector<uint8_t> decodeReference(const uint8_t* buf)
+    {
+        const uint32_t numEntries = *(uint16_t*)buf;
+        const uint32_t uncompressedSize = *(uint32_t*)(buf + 2);
+        const uint8_t* entries = buf + 6;
+        const uint8_t* data = entries + numEntries * 6;
+
+        ReferenceNode** root = new ReferenceNode*(new ReferenceNode{});
+        for (uint32_t i = 0; i < numEntries; ++i)
+        {
+            insertReferenceEntry(*root, entries + i * 6);
+        }
+
+        std::vector<uint8_t> res(uncompressedSize);
+
+        ReferenceState state{ 0, 0, *root };
+        for (uint32_t i = 0; i < uncompressedSize; ++i)
+        {
+            while (!decodeReferenceByte(*root, data, state, res[i]))
+            {
+            }
+        }
+
+        destroyReferenceNode(*root);
+        delete root;
+
+        return res;
+    }
+
+    std::vector<uint8_t> decodeTable(const uint8_t* buf)
+    {
+        TextDecoder decoder;
+        decoder.begin(buf);
+
+        std::vector<uint8_t> res(decoder.getUncompressedSize());
+        decoder.decodeInto(res.data(), res.size());
+        return res;
+    }
+
+} // namespace openhedz::textpack
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace openhedz::textpack
+{
+    // Port of the original decoder (0x00424A20) including the stopping rules of its bit by bit tree walker,
+    // its allocation per tree node and its call per output byte. Used to validate and measure the table
+    // driven decoder.
+    std::vector<uint8_t> decodeReference(const uint8_t* buf);
+
+    // Decodes the whole blob with TextDecoder.
+    std::vector<uint8_t> decodeTable(const uint8_t* buf);
+
+} // namespace openhedz::textpack
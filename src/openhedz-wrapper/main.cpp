@@ -1,22 +1,81 @@
 #include <openhedz/core/diagnostics/logging.hpp>
+#include <openhedz/core/diagnostics/logrecorder.hpp>
 #include <openhedz/core/interop/hooks.hpp>
 #include <openhedz/core/interop/interop.hpp>
 #include <openhedz/core/interop/win_min.hpp>
 
+#include <cstdio>
+#include <cstring>
+
 using namespace openhedz;
 
 namespace logging = diagnostics::logging;
 
+// Names the reimplementation a crash happened in, the registry is built by then. Anything else is given as
+// an offset into its module, which the symbols of that module can resolve later.
+static bool describeCrashAddress(uintptr_t address, char* buffer, size_t size)
+{
+    if (const auto* hook = interop::hooks::findByTarget(address))
+    {
+        const auto offset = static_cast<unsigned>(address - reinterpret_cast<uintptr_t>(hook->target));
+        snprintf(buffer, size, "hook %s+0x%X", hook->name, offset);
+        return true;
+    }
+
+    HMODULE module = nullptr;
+    if (!GetModuleHandleExA(
+            GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+            reinterpret_cast<LPCSTR>(address), &module))
+        return false;
+
+    char path[MAX_PATH];
+    if (GetModuleFileNameA(module, path, MAX_PATH) == 0)
+        return false;
+
+    const char* fileName = strrchr(path, '\\');
+    fileName = fileName != nullptr ? fileName + 1 : path;
+
+    const auto offset = static_cast<unsigned>(address - reinterpret_cast<uintptr_t>(module));
+    snprintf(buffer, size, "%s+0x%X", fileName, offset);
+    return true;
+}
+
 BOOL WINAPI DllMain(void* _DllHandle, unsigned long _Reason, void* _Reserved)
 {
     if (_Reason == DLL_PROCESS_ATTACH)
     {
-        logging::init("openhedz.log", { true, false });
+        logging::Options logOpts{ true, false };
+        logOpts.Console = strstr(GetCommandLineA(), "-noconsole") == nullptr;
+        logOpts.Async = strstr(GetCommandLineA(), "-asynclog") != nullptr;
+        logOpts.Binary = strstr(GetCommandLineA(), "-binarylog") != nullptr;
+        logOpts.Batched = strstr(GetCommandLineA(), "-batchlog") != nullptr;
+        logOpts.Mapped = strstr(GetCommandLineA(), "-mappedlog") != nullptr;
+        logOpts.Json = strstr(GetCommandLineA(), "-jsonlog") != nullptr;
+        if (strstr(GetCommandLineA(), "-flightrecorder") != nullptr)
+        {
+            logOpts.RecorderSize = 1024;
+        }
+
+        const bool fileLog = strstr(GetCommandLineA(), "-nofilelog") == nullptr;
+        logging::init(fileLog ? "openhedz.log" : "", logOpts);
+        logging::configureLevels(GetCommandLineA());
 
         interop::init();
-        interop::hooks::init();
 
-        logging::echo("Initialized\n");
+        // Without the hooks the unmodified game would start as if nothing happened.
+        if (!interop::hooks::init(strstr(GetCommandLineA(), "-hookprofile") != nullptr))
+        {
+            logging::err(LOG_FMT("Failed to apply the hooks, not starting\n"));
+            logging::flush();
+            return FALSE;
+        }
+
+        if (auto* recorder = logging::get().getRecorder())
+        {
+            recorder->installCrashHandler("openhedz.crash.log", describeCrashAddress);
+        }
+
+        logging::echo(LOG_FMT("Initialized\n"));
     }
 
     return TRUE;
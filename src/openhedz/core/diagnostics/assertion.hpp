@@ -187,13 +187,13 @@ namespace openhedz::diagnostics::assertion
             if (message != nullptr)
             {
                 logging::err(
-                    "%s:%d Assertion failure (%s %s %s) - %s\n", file, line, detail::ValueGetter<decltype(a)>::get(a), cmp,
-                    detail::ValueGetter<decltype(b)>::get(b), message);
+                    LOG_FMT("%s:%d Assertion failure (%s %s %s) - %s\n"), file, line,
+                    detail::ValueGetter<decltype(a)>::get(a), cmp, detail::ValueGetter<decltype(b)>::get(b), message);
             }
             else
             {
                 logging::err(
-                    "%s:%d Assertion failure (%s %s %s)\n", file, line, detail::ValueGetter<decltype(a)>::get(a), cmp,
+                    LOG_FMT("%s:%d Assertion failure (%s %s %s)\n"), file, line, detail::ValueGetter<decltype(a)>::get(a), cmp,
                     detail::ValueGetter<decltype(b)>::get(b));
             }
         }
@@ -206,11 +206,11 @@ namespace openhedz::diagnostics::assertion
     {
         if (message != nullptr)
         {
-            logging::err("%s:%d Assertion failure - %s\n", file, line, message);
+            logging::err(LOG_FMT("%s:%d Assertion failure - %s\n"), file, line, message);
         }
         else
         {
-            logging::err("%s:%d Assertion failure\n", file, line);
+            logging::err(LOG_FMT("%s:%d Assertion failure\n"), file, line);
         }
 
         debugging::halt();
@@ -218,7 +218,7 @@ namespace openhedz::diagnostics::assertion
 
     inline void fail(const std::string& message, WITH_LINE_INFO)
     {
-        logging::err("%s:%d Assertion failure - %s\n", file, line, message);
+        logging::err(LOG_FMT("%s:%d Assertion failure - %s\n"), file, line, message);
         debugging::halt();
     }
 
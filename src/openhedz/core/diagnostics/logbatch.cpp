@@ -0,0 +1,166 @@
+﻿#include "logbatch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace openhedz::diagnostics::logging
+{
+    static std::atomic<uint32_t> _nextSlot{ 0 };
+    static thread_local uint32_t _threadSlot = _nextSlot++;
+
+    LogBatch::LogBatch(FILE* fp)
+        : _fp(fp)
+        , _start(Clock::now())
+    {
+        _flusher = std::thread([this]() { flusherThread(); });
+    }
+
+    LogBatch::~LogBatch()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_flusherMutex);
+            _stopFlusher = true;
+        }
+        _flusherCv.notify_one();
+        if (_flusher.joinable())
+        {
+            _flusher.join();
+        }
+        flush(UINT64_MAX);
+    }
+
+    void LogBatch::append(const char* prefix, const char* txt)
+    {
+        const size_t prefixLen = strlen(prefix);
+        const size_t txtLen = strlen(txt);
+        const uint32_t length = static_cast<uint32_t>(prefixLen + txtLen);
+
+        size_t slotSize = 0;
+        {
+            Slot& slot = _slots[_threadSlot % kSlotCount];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+
+            // Taken under the lock, a flush with a later cutoff is guaranteed to see this record.
+            const uint64_t timestamp = getTimestamp();
+            const size_t pos = slot.data.size();
+            slot.data.resize(pos + sizeof(timestamp) + sizeof(length) + length);
+
+            char* dst = slot.data.data() + pos;
+            std::memcpy(dst, &timestamp, sizeof(timestamp));
+            dst += sizeof(timestamp);
+            std::memcpy(dst, &length, sizeof(length));
+            dst += sizeof(length);
+            std::memcpy(dst, prefix, prefixLen);
+            std::memcpy(dst + prefixLen, txt, txtLen);
+
+            slotSize = slot.data.size();
+        }
+
+        if (slotSize >= kMaxSlotSize)
+        {
+            flush();
+        }
+        else if (slotSize >= kFlushSize && !_flushRequested.exchange(true))
+        {
+            // Not taking the flusher lock, a missed wakeup is covered by the flush interval.
+            _flusherCv.notify_one();
+        }
+    }
+
+    void LogBatch::flush()
+    {
+        flush(getTimestamp());
+    }
+
+    void LogBatch::collect(const std::vector<char>& data, uint64_t cutoff)
+    {
+        for (size_t pos = 0; pos < data.size();)
+        {
+            const size_t start = pos;
+
+            Entry entry{};
+            std::memcpy(&entry.timestamp, data.data() + pos, sizeof(entry.timestamp));
+            pos += sizeof(entry.timestamp);
+            std::memcpy(&entry.length, data.data() + pos, sizeof(entry.length));
+            pos += sizeof(entry.length);
+            entry.text = data.data() + pos;
+            pos += entry.length;
+
+            if (entry.timestamp <= cutoff)
+            {
+                _entries.push_back(entry);
+            }
+            else
+            {
+                _carry.insert(_carry.end(), data.data() + start, data.data() + pos);
+            }
+        }
+    }
+
+    void LogBatch::flush(uint64_t cutoff)
+    {
+        std::lock_guard<std::mutex> flushLock(_flushMutex);
+
+        for (size_t i = 0; i < kSlotCount; ++i)
+        {
+            Slot& slot = _slots[i];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            _pending[i].clear();
+            std::swap(_pending[i], slot.data);
+        }
+
+        // Records newer than the cutoff wait for the next batch, which also gets everything staged
+        // between the cutoff and the slots being taken.
+        std::swap(_carryPending, _carry);
+        _carry.clear();
+
+        _entries.clear();
+        collect(_carryPending, cutoff);
+        for (const auto& data : _pending)
+        {
+            collect(data, cutoff);
+        }
+
+        if (_entries.empty())
+            return;
+
+        // Records of a slot are already sorted, the stable sort interleaves the slots.
+        std::stable_sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        size_t totalSize = 0;
+        for (const auto& entry : _entries)
+        {
+            totalSize += entry.length;
+        }
+
+        _output.resize(totalSize);
+        char* dst = _output.data();
+        for (const auto& entry : _entries)
+        {
+            std::memcpy(dst, entry.text, entry.length);
+            dst += entry.length;
+        }
+
+        fwrite(_output.data(), 1, _output.size(), _fp);
+        fflush(_fp);
+    }
+
+    void LogBatch::flusherThread()
+    {
+        std::unique_lock<std::mutex> lock(_flusherMutex);
+        while (!_stopFlusher)
+        {
+            _flusherCv.wait_for(lock, kFlushInterval, [this]() { return _stopFlusher || _flushRequested.load(); });
+            if (_stopFlusher)
+                break;
+
+            _flushRequested = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openhedz::diagnostics::logging
+{
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4324) // Padding due to alignas is intended.
+#endif
+
+    // Stages file output in buffers per thread and writes them in large batches, on size, on a
+    // timer or on flush. Batches are merged by timestamp so the file keeps the order of the calls.
+    class LogBatch
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // Threads are assigned slots round robin, threads beyond the slot count share them.
+        static constexpr size_t kSlotCount = 16;
+        // A slot reaching kFlushSize wakes the flusher, only a slot reaching kMaxSlotSize makes the thread
+        // appending to it write the batch itself.
+        static constexpr size_t kFlushSize = 64 * 1024;
+        static constexpr size_t kMaxSlotSize = 1024 * 1024;
+        static constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+        struct alignas(64) Slot
+        {
+            std::mutex mutex;
+            // Records of {uint64 timestamp, uint32 length, text}.
+            std::vector<char> data;
+        };
+
+        struct Entry
+        {
+            uint64_t timestamp;
+            const char* text;
+            uint32_t length;
+        };
+
+        FILE* _fp;
+        Clock::time_point _start;
+        Slot _slots[kSlotCount];
+
+        // Held while a batch is written, the vectors are reused between batches.
+        std::mutex _flushMutex;
+        std::vector<char> _pending[kSlotCount];
+        // Records staged after the cutoff of the previous batch.
+        std::vector<char> _carry;
+        std::vector<char> _carryPending;
+        std::vector<Entry> _entries;
+        std::vector<char> _output;
+
+        std::thread _flusher;
+        std::mutex _flusherMutex;
+        std::condition_variable _flusherCv;
+        bool _stopFlusher = false;
+        std::atomic<bool> _flushRequested{ false };
+
+    public:
+        explicit LogBatch(FILE* fp);
+        ~LogBatch();
+
+        LogBatch(const LogBatch&) = delete;
+        LogBatch& operator=(const LogBatch&) = delete;
+
+        void append(const char* prefix, const char* txt);
+
+        // Writes everything staged so far.
+        void flush();
+
+    private:
+        uint64_t getTimestamp() const
+        {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _start).count());
+        }
+
+        void collect(const std::vector<char>& data, uint64_t cutoff);
+        void flush(uint64_t cutoff);
+        void flusherThread();
+    };
+
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
+
+} // namespace openhedz::diagnostics::logging
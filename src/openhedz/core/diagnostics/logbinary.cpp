@@ -0,0 +1,234 @@
+﻿#include "logbinary.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4996) // Secure CRT warnings, don't care.
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+
+namespace openhedz::diagnostics::logging
+{
+    namespace Detail
+    {
+        struct BinaryThreadBuffer
+        {
+            static constexpr size_t kCapacity = 64 * 1024;
+
+            // Only contended when another thread flushes.
+            std::mutex mutex;
+            BinaryLog* owner = nullptr;
+            uint32_t threadId = 0;
+            size_t used = 0;
+            std::unique_ptr<uint8_t[]> data = std::make_unique<uint8_t[]>(kCapacity);
+            std::unordered_set<const char*> knownFormats;
+        };
+
+    } // namespace Detail
+
+    struct BinaryRegistry
+    {
+        // Guards the owner of every thread buffer and the buffer list.
+        std::mutex mutex;
+        std::vector<Detail::BinaryThreadBuffer*> buffers;
+    };
+
+    // Never destroyed, log handles and thread buffers may outlive the static objects of this file.
+    static BinaryRegistry& getRegistry()
+    {
+        static auto* registry = new BinaryRegistry();
+        return *registry;
+    }
+
+    static void unregisterBuffer(Detail::BinaryThreadBuffer* buffer)
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> registryLock(registry.mutex);
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            if (buffer->owner != nullptr)
+            {
+                buffer->owner->writeChunk(*buffer);
+                buffer->owner = nullptr;
+            }
+        }
+
+        auto it = std::find(registry.buffers.begin(), registry.buffers.end(), buffer);
+        if (it != registry.buffers.end())
+        {
+            registry.buffers.erase(it);
+        }
+    }
+
+    struct BinaryThreadState
+    {
+        std::unique_ptr<Detail::BinaryThreadBuffer> buffer;
+
+        ~BinaryThreadState()
+        {
+            if (buffer)
+            {
+                unregisterBuffer(buffer.get());
+            }
+        }
+    };
+
+    static thread_local BinaryThreadState _threadState;
+
+    BinaryLog::BinaryLog(const std::string& fileName)
+        : _start(Clock::now())
+    {
+        _fp = _fsopen(fileName.c_str(), "wb", _SH_DENYWR);
+        if (_fp != nullptr)
+        {
+            fwrite(binary::kFileMagic, sizeof(binary::kFileMagic), 1, _fp);
+        }
+    }
+
+    BinaryLog::~BinaryLog()
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> registryLock(registry.mutex);
+        for (auto* buffer : registry.buffers)
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            if (buffer->owner == this)
+            {
+                writeChunk(*buffer);
+                buffer->owner = nullptr;
+            }
+        }
+
+        if (_fp != nullptr)
+        {
+            fclose(_fp);
+        }
+    }
+
+    void BinaryLog::flush()
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> registryLock(registry.mutex);
+        for (auto* buffer : registry.buffers)
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            if (buffer->owner == this)
+            {
+                writeChunk(*buffer);
+            }
+        }
+
+        if (_fp != nullptr)
+        {
+            fflush(_fp);
+        }
+    }
+
+    void BinaryLog::writeChunk(Detail::BinaryThreadBuffer& buffer)
+    {
+        if (buffer.used == 0)
+            return;
+
+        if (_fp != nullptr)
+        {
+            // Chunks are written by whoever holds the thread buffer, the file itself is locked by the CRT.
+            const uint32_t header[2] = { buffer.threadId, static_cast<uint32_t>(buffer.used) };
+            _lock_file(_fp);
+            _fwrite_nolock(header, sizeof(header), 1, _fp);
+            _fwrite_nolock(buffer.data.get(), buffer.used, 1, _fp);
+            _unlock_file(_fp);
+        }
+
+        buffer.used = 0;
+    }
+
+    bool BinaryLog::beginRecord(const char* fmt, size_t size, Detail::BinaryRecordWriter& w)
+    {
+        auto& state = _threadState;
+        if (!state.buffer)
+        {
+            state.buffer = std::make_unique<Detail::BinaryThreadBuffer>();
+            state.buffer->threadId = GetCurrentThreadId();
+
+            auto& registry = getRegistry();
+            std::lock_guard<std::mutex> registryLock(registry.mutex);
+            registry.buffers.push_back(state.buffer.get());
+        }
+
+        auto& buffer = *state.buffer;
+        buffer.mutex.lock();
+
+        if (buffer.owner != this)
+        {
+            // Rare, only when the thread logs to a different binary log than before.
+            buffer.mutex.unlock();
+
+            auto& registry = getRegistry();
+            std::lock_guard<std::mutex> registryLock(registry.mutex);
+            buffer.mutex.lock();
+            if (buffer.owner != nullptr)
+            {
+                buffer.owner->writeChunk(buffer);
+            }
+            buffer.used = 0;
+            buffer.knownFormats.clear();
+            buffer.owner = this;
+        }
+
+        size_t formatSize = 0;
+        uint32_t formatLen = 0;
+        const bool newFormat = buffer.knownFormats.count(fmt) == 0;
+        if (newFormat)
+        {
+            formatLen = static_cast<uint32_t>(strlen(fmt));
+            formatSize = 1 + sizeof(uint64_t) + sizeof(uint32_t) + formatLen;
+        }
+
+        if (formatSize + size > Detail::BinaryThreadBuffer::kCapacity)
+        {
+            buffer.mutex.unlock();
+            return false;
+        }
+
+        if (buffer.used + formatSize + size > Detail::BinaryThreadBuffer::kCapacity)
+        {
+            writeChunk(buffer);
+        }
+
+        w.buffer = &buffer;
+        w.pos = buffer.data.get() + buffer.used;
+
+        if (newFormat)
+        {
+            buffer.knownFormats.insert(fmt);
+            w.put(binary::kRecordFormat);
+            w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(fmt)));
+            w.put(formatLen);
+            w.putBytes(fmt, formatLen);
+        }
+
+        return true;
+    }
+
+    void BinaryLog::endRecord(Detail::BinaryRecordWriter& w)
+    {
+        auto& buffer = *w.buffer;
+        buffer.used = static_cast<size_t>(w.pos - buffer.data.get());
+        buffer.mutex.unlock();
+    }
+
+} // namespace openhedz::diagnostics::logging
+
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
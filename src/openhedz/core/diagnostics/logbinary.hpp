@@ -0,0 +1,173 @@
+﻿#pragma once
+
+#include "logbinaryformat.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace openhedz::diagnostics::logging
+{
+    namespace Detail
+    {
+        enum class MsgType;
+
+        struct BinaryThreadBuffer;
+
+        // Position in a locked thread buffer, created by BinaryLog::beginRecord.
+        struct BinaryRecordWriter
+        {
+            BinaryThreadBuffer* buffer;
+            uint8_t* pos;
+
+            template<typename T> void put(const T& v)
+            {
+                std::memcpy(pos, &v, sizeof(T));
+                pos += sizeof(T);
+            }
+
+            void putBytes(const void* data, size_t size)
+            {
+                std::memcpy(pos, data, size);
+                pos += size;
+            }
+        };
+
+        inline uint32_t binaryStringLength(const char* str)
+        {
+            if (str == nullptr)
+                return 0;
+
+            const size_t len = strnlen(str, binary::kMaxStringArg);
+            return static_cast<uint32_t>(len);
+        }
+
+        inline uint32_t binaryStringLength(const wchar_t* str)
+        {
+            if (str == nullptr)
+                return 0;
+
+            const size_t len = wcsnlen(str, binary::kMaxStringArg);
+            return static_cast<uint32_t>(len);
+        }
+
+        template<typename T> constexpr bool IsBinaryStringV = std::is_same_v<T, const char*> || std::is_same_v<T, char*>
+            || std::is_same_v<T, const wchar_t*> || std::is_same_v<T, wchar_t*>;
+
+        template<typename T> inline size_t binaryArgSize(const T& v)
+        {
+            using TArg = std::decay_t<T>;
+            if constexpr (IsBinaryStringV<TArg>)
+                return 1 + sizeof(uint32_t) + binaryStringLength(v);
+            else
+                return 1 + sizeof(uint64_t);
+        }
+
+        template<typename T> inline void writeBinaryArg(BinaryRecordWriter& w, const T& v)
+        {
+            using TArg = std::decay_t<T>;
+            if constexpr (IsBinaryStringV<TArg>)
+            {
+                const uint32_t len = binaryStringLength(v);
+                w.put(binary::kArgString);
+                w.put(len);
+                if constexpr (std::is_same_v<std::remove_const_t<std::remove_pointer_t<TArg>>, wchar_t>)
+                {
+                    // Wide strings are narrowed, log text is expected to be ASCII.
+                    for (uint32_t i = 0; i < len; ++i)
+                    {
+                        w.put(static_cast<char>(v[i]));
+                    }
+                }
+                else
+                {
+                    w.putBytes(v, len);
+                }
+            }
+            else if constexpr (std::is_floating_point_v<TArg>)
+            {
+                w.put(binary::kArgDouble);
+                w.put(static_cast<double>(v));
+            }
+            else if constexpr (std::is_pointer_v<TArg> || std::is_null_pointer_v<TArg>)
+            {
+                w.put(binary::kArgPointer);
+                w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(v)));
+            }
+            else if constexpr (std::is_enum_v<TArg>)
+            {
+                w.put(binary::kArgSigned);
+                w.put(static_cast<int64_t>(v));
+            }
+            else if constexpr (std::is_unsigned_v<TArg>)
+            {
+                w.put(binary::kArgUnsigned);
+                w.put(static_cast<uint64_t>(v));
+            }
+            else
+            {
+                static_assert(std::is_integral_v<TArg>, "Unsupported argument type for binary logging");
+                w.put(binary::kArgSigned);
+                w.put(static_cast<int64_t>(v));
+            }
+        }
+
+    } // namespace Detail
+
+    // Records messages without formatting them, the format string is stored once per thread and
+    // messages only store its id, a timestamp and the raw arguments. Records are staged in a buffer
+    // per thread and written to the file in chunks.
+    class BinaryLog
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        FILE* _fp = nullptr;
+        Clock::time_point _start;
+
+    public:
+        explicit BinaryLog(const std::string& fileName);
+        ~BinaryLog();
+
+        BinaryLog(const BinaryLog&) = delete;
+        BinaryLog& operator=(const BinaryLog&) = delete;
+
+        template<typename... Args> void write(Detail::MsgType type, const char* fmt, const Args&... args)
+        {
+            constexpr size_t kHeaderSize = 1 + 1 + sizeof(uint64_t) + sizeof(uint64_t) + 1;
+            const size_t size = (kHeaderSize + ... + Detail::binaryArgSize(args));
+
+            Detail::BinaryRecordWriter w{};
+            if (!beginRecord(fmt, size, w))
+                return;
+
+            w.put(binary::kRecordMessage);
+            w.put(static_cast<uint8_t>(type));
+            w.put(getTimestamp());
+            w.put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(fmt)));
+            w.put(static_cast<uint8_t>(sizeof...(args)));
+            (Detail::writeBinaryArg(w, args), ...);
+
+            endRecord(w);
+        }
+
+        // Writes the staged records of all threads to the file.
+        void flush();
+
+        // Called by a thread buffer, expects the buffer to be locked.
+        void writeChunk(Detail::BinaryThreadBuffer& buffer);
+
+    private:
+        uint64_t getTimestamp() const
+        {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _start).count());
+        }
+
+        bool beginRecord(const char* fmt, size_t size, Detail::BinaryRecordWriter& w);
+        void endRecord(Detail::BinaryRecordWriter& w);
+    };
+
+} // namespace openhedz::diagnostics::logging
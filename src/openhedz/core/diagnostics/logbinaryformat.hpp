@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// Layout of binary log files, kept free of any platform dependencies so offline tools can use it.
+//
+// File: header, followed by chunks of {uint32 threadId, uint32 size, records}.
+// Format record: tag, uint64 format id, uint32 length, characters.
+// Message record: tag, uint8 type, uint64 timestamp in microseconds, uint64 format id, uint8 arg count, args.
+// Argument: tag, followed by 8 bytes or for strings a uint32 length and the characters.
+namespace openhedz::diagnostics::logging::binary
+{
+    inline constexpr char kFileMagic[8] = { 'H', 'D', 'Z', 'B', 'L', 'O', 'G', '1' };
+
+    inline constexpr uint8_t kRecordFormat = 'F';
+    inline constexpr uint8_t kRecordMessage = 'M';
+
+    inline constexpr uint8_t kArgSigned = 'i';
+    inline constexpr uint8_t kArgUnsigned = 'u';
+    inline constexpr uint8_t kArgDouble = 'd';
+    inline constexpr uint8_t kArgPointer = 'p';
+    inline constexpr uint8_t kArgString = 's';
+
+    // Longer string arguments are truncated.
+    inline constexpr uint32_t kMaxStringArg = 1024;
+
+} // namespace openhedz::diagnostics::logging::binary
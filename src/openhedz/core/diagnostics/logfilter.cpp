@@ -0,0 +1,60 @@
+﻿#include "logfilter.hpp"
+
+#include <cstring>
+#include <iterator>
+
+namespace openhedz::diagnostics::logging
+{
+    static constexpr const char* kCategoryNames[] = {
+        "hooks", "interop", "text", "render", "net", "input",
+    };
+    static_assert(std::size(kCategoryNames) == static_cast<size_t>(Category::Count));
+
+    static constexpr const char* kLevelNames[] = {
+        "off", "error", "warning", "info", "verbose",
+    };
+
+    const char* getCategoryName(Category category)
+    {
+        return kCategoryNames[static_cast<size_t>(category)];
+    }
+
+    // Compares the token up to the next delimiter.
+    static bool matchToken(const char* str, size_t len, const char* name)
+    {
+        return strlen(name) == len && strncmp(str, name, len) == 0;
+    }
+
+    void configureLevels(const char* cmdLine)
+    {
+        constexpr const char kOption[] = "-log:";
+
+        for (const char* opt = strstr(cmdLine, kOption); opt != nullptr; opt = strstr(opt, kOption))
+        {
+            opt += sizeof(kOption) - 1;
+
+            const char* sep = strchr(opt, '=');
+            if (sep == nullptr)
+                break;
+
+            const char* value = sep + 1;
+            const size_t valueLen = strcspn(value, " \t\"");
+
+            size_t level = 0;
+            while (level < std::size(kLevelNames) && !matchToken(value, valueLen, kLevelNames[level]))
+                ++level;
+            if (level == std::size(kLevelNames))
+                continue;
+
+            const size_t nameLen = static_cast<size_t>(sep - opt);
+            for (size_t i = 0; i < std::size(kCategoryNames); ++i)
+            {
+                if (matchToken(opt, nameLen, "all") || matchToken(opt, nameLen, kCategoryNames[i]))
+                {
+                    setLevel(static_cast<Category>(i), static_cast<Level>(level));
+                }
+            }
+        }
+    }
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace openhedz::diagnostics::logging
+{
+    enum class Category : uint8_t
+    {
+        Hooks,
+        Interop,
+        Text,
+        Render,
+        Net,
+        Input,
+        Count,
+    };
+
+    enum class Level : uint8_t
+    {
+        Off,
+        Error,
+        Warning,
+        Info,
+        Verbose,
+    };
+
+    namespace Detail
+    {
+        inline std::atomic<Level> categoryLevels[static_cast<size_t>(Category::Count)] = {
+            Level::Info, Level::Info, Level::Info, Level::Info, Level::Info, Level::Info,
+        };
+
+    } // namespace Detail
+
+    // Checked before anything is formatted, disabled messages cost a single load.
+    inline bool isEnabled(Category category, Level level)
+    {
+        return Detail::categoryLevels[static_cast<size_t>(category)].load(std::memory_order_relaxed) >= level;
+    }
+
+    inline void setLevel(Category category, Level level)
+    {
+        Detail::categoryLevels[static_cast<size_t>(category)].store(level, std::memory_order_relaxed);
+    }
+
+    inline Level getLevel(Category category)
+    {
+        return Detail::categoryLevels[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+    }
+
+    const char* getCategoryName(Category category);
+
+    // Applies every -log:<category>=<level> option, category may be "all". Levels are off, error,
+    // warning, info and verbose.
+    void configureLevels(const char* cmdLine);
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,316 @@
+﻿#include "logformat.hpp"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace openhedz::diagnostics::logging::Detail
+{
+    template<typename... Args> constexpr FormatError checkFormat(std::string_view fmt)
+    {
+        return validateFormat<8, Args...>(fmt, parseFormatSegments<8>(fmt));
+    }
+
+    static_assert(checkFormat<int, unsigned, uint8_t, int16_t>("%d %u %hhx %hd") == FormatError::None);
+    static_assert(checkFormat<uint64_t, int64_t, int64_t>("%llu %lld %I64x") == FormatError::None);
+    static_assert(checkFormat<size_t, ptrdiff_t, size_t>("%zu %td %Iu") == FormatError::None);
+    static_assert(checkFormat<long, unsigned long, char>("%ld %lX %c") == FormatError::None);
+    static_assert(checkFormat<const char*, const wchar_t*, double, void*>("%s %ls %.2f %p") == FormatError::None);
+
+    static_assert(checkFormat<uint64_t>("%d") == FormatError::ArgumentType);
+    static_assert(checkFormat<int64_t>("%x") == FormatError::ArgumentType);
+    static_assert(checkFormat<int>("%llu") == FormatError::ArgumentType);
+    static_assert(checkFormat<int64_t>("%hhx") == FormatError::ArgumentType);
+    static_assert(checkFormat<uint32_t>("%I64u") == FormatError::ArgumentType);
+    static_assert(checkFormat<int64_t>("%c") == FormatError::ArgumentType);
+    static_assert(checkFormat<double>("%d") == FormatError::ArgumentType);
+    static_assert(checkFormat<int>("%s") == FormatError::ArgumentType);
+
+    void FormatBuffer::append(const char* str, size_t len)
+    {
+        if (_size + len > _capacity)
+        {
+            size_t capacity = _capacity * 2;
+            while (capacity < _size + len)
+                capacity *= 2;
+
+            auto heap = std::make_unique<char[]>(capacity);
+            std::memcpy(heap.get(), _data, _size);
+            _heap = std::move(heap);
+            _data = _heap.get();
+            _capacity = capacity;
+        }
+        std::memcpy(_data + _size, str, len);
+        _size += len;
+    }
+
+    // Integers are stored widened, printf semantics apply to the size of the original type or the
+    // smaller size an 'h' or 'hh' modifier asks for.
+    static size_t getIntSize(const FormatSegment& seg, const FormatArg& arg)
+    {
+        return seg.intSize != 0 && seg.intSize < arg.size ? seg.intSize : arg.size;
+    }
+
+    static int64_t getSigned(const FormatSegment& seg, const FormatArg& arg)
+    {
+        switch (getIntSize(seg, arg))
+        {
+            case 1:
+                return static_cast<int8_t>(arg.u);
+            case 2:
+                return static_cast<int16_t>(arg.u);
+            case 4:
+                return static_cast<int32_t>(arg.u);
+            default:
+                return arg.i;
+        }
+    }
+
+    static uint64_t getUnsigned(const FormatSegment& seg, const FormatArg& arg)
+    {
+        switch (getIntSize(seg, arg))
+        {
+            case 1:
+                return static_cast<uint8_t>(arg.u);
+            case 2:
+                return static_cast<uint16_t>(arg.u);
+            case 4:
+                return static_cast<uint32_t>(arg.u);
+            default:
+                return arg.u;
+        }
+    }
+
+    template<typename T> static size_t integerToChars(char* buf, size_t size, T value, int base, bool upper)
+    {
+        auto res = std::to_chars(buf, buf + size, value, base);
+        if (upper)
+        {
+            for (char* p = buf; p != res.ptr; ++p)
+            {
+                if (*p >= 'a' && *p <= 'f')
+                    *p = static_cast<char>(*p - 'a' + 'A');
+            }
+        }
+        return static_cast<size_t>(res.ptr - buf);
+    }
+
+    static void appendFill(FormatBuffer& out, char c, size_t count)
+    {
+        char fill[32];
+        std::memset(fill, c, sizeof(fill));
+        for (; count > sizeof(fill); count -= sizeof(fill))
+            out.append(fill, sizeof(fill));
+        out.append(fill, count);
+    }
+
+    // Applies the width of the segment, zero padding goes after the sign.
+    static void appendPadded(FormatBuffer& out, const FormatSegment& seg, const char* text, size_t len, bool numeric)
+    {
+        const size_t pad = seg.width > len ? seg.width - len : 0;
+        if (pad == 0)
+        {
+            out.append(text, len);
+        }
+        else if (seg.leftAlign)
+        {
+            out.append(text, len);
+            appendFill(out, ' ', pad);
+        }
+        else if (seg.zeroPad && numeric)
+        {
+            if (len != 0 && text[0] == '-')
+            {
+                out.append('-');
+                ++text;
+                --len;
+            }
+            appendFill(out, '0', pad);
+            out.append(text, len);
+        }
+        else
+        {
+            appendFill(out, ' ', pad);
+            out.append(text, len);
+        }
+    }
+
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4774)
+#endif
+    template<typename T> static void appendPrintf(FormatBuffer& out, const char* spec, T value)
+    {
+        char temp[128];
+        const int len = snprintf(temp, sizeof(temp), spec, value);
+        if (len < 0)
+            return;
+
+        if (static_cast<size_t>(len) < sizeof(temp))
+        {
+            out.append(temp, static_cast<size_t>(len));
+            return;
+        }
+
+        auto large = std::make_unique<char[]>(static_cast<size_t>(len) + 1);
+        snprintf(large.get(), static_cast<size_t>(len) + 1, spec, value);
+        out.append(large.get(), static_cast<size_t>(len));
+    }
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
+
+    // Conversions with flags, width or precision go through snprintf with a rebuilt specification.
+    static void formatWithSpec(FormatBuffer& out, const char* fmt, const FormatSegment& seg, const FormatArg& arg)
+    {
+        char spec[32];
+        size_t len = 0;
+        spec[len++] = '%';
+
+        const size_t specLength = seg.length < sizeof(spec) - 5 ? seg.length : sizeof(spec) - 5;
+        std::memcpy(spec + len, fmt + seg.offset, specLength);
+        len += specLength;
+
+        switch (seg.conversion)
+        {
+            case 'd':
+            case 'i':
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = 'd';
+                spec[len] = '\0';
+                appendPrintf(out, spec, static_cast<long long>(getSigned(seg, arg)));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = seg.conversion;
+                spec[len] = '\0';
+                appendPrintf(out, spec, static_cast<unsigned long long>(getUnsigned(seg, arg)));
+                break;
+            case 'c':
+                spec[len++] = 'c';
+                spec[len] = '\0';
+                appendPrintf(out, spec, static_cast<int>(getSigned(seg, arg)));
+                break;
+            case 's':
+                if (arg.kind == FormatArgKind::WideString)
+                {
+                    spec[len++] = 'l';
+                    spec[len++] = 's';
+                    spec[len] = '\0';
+                    appendPrintf(out, spec, arg.ws);
+                }
+                else
+                {
+                    spec[len++] = 's';
+                    spec[len] = '\0';
+                    appendPrintf(out, spec, arg.s);
+                }
+                break;
+            case 'p':
+                spec[len++] = 'p';
+                spec[len] = '\0';
+                appendPrintf(out, spec, arg.p);
+                break;
+            default:
+                spec[len++] = seg.conversion;
+                spec[len] = '\0';
+                appendPrintf(out, spec, arg.d);
+                break;
+        }
+    }
+
+    // Formats the conversions that do not need snprintf, returns false for anything else.
+    static bool formatNative(FormatBuffer& out, const FormatSegment& seg, const FormatArg& arg)
+    {
+        if (!seg.simple)
+            return false;
+
+        char temp[sizeof(void*) * 2 > 24 ? sizeof(void*) * 2 : 24];
+        size_t len = 0;
+
+        switch (seg.conversion)
+        {
+            case 'd':
+            case 'i':
+                if (seg.precision >= 0)
+                    return false;
+                len = integerToChars(temp, sizeof(temp), getSigned(seg, arg), 10, false);
+                appendPadded(out, seg, temp, len, true);
+                return true;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            {
+                if (seg.precision >= 0)
+                    return false;
+                const int base = seg.conversion == 'u' ? 10 : (seg.conversion == 'o' ? 8 : 16);
+                len = integerToChars(temp, sizeof(temp), getUnsigned(seg, arg), base, seg.conversion == 'X');
+                appendPadded(out, seg, temp, len, true);
+                return true;
+            }
+            case 'c':
+                temp[0] = static_cast<char>(getSigned(seg, arg));
+                appendPadded(out, seg, temp, 1, false);
+                return true;
+            case 's':
+            {
+                if (arg.kind == FormatArgKind::WideString || seg.zeroPad)
+                    return false;
+
+                const char* str = arg.s != nullptr ? arg.s : "(null)";
+                if (seg.precision >= 0)
+                    len = strnlen(str, static_cast<size_t>(seg.precision));
+                else
+                    len = strlen(str);
+                appendPadded(out, seg, str, len, false);
+                return true;
+            }
+            case 'p':
+            {
+                if (seg.precision >= 0 || seg.zeroPad)
+                    return false;
+
+                // Same layout as the MSVC runtime, zero padded uppercase hex.
+                auto value = reinterpret_cast<uintptr_t>(arg.p);
+                len = sizeof(void*) * 2;
+                for (size_t n = len; n > 0; --n)
+                {
+                    temp[n - 1] = "0123456789ABCDEF"[value & 0xF];
+                    value >>= 4;
+                }
+                appendPadded(out, seg, temp, len, false);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void formatSegments(
+        const char* fmt, const FormatSegment* segments, size_t segmentCount, const FormatArg* args, FormatBuffer& out)
+    {
+        size_t argIndex = 0;
+        for (size_t i = 0; i < segmentCount; ++i)
+        {
+            const FormatSegment& seg = segments[i];
+            if (seg.conversion == '\0')
+            {
+                out.append(fmt + seg.offset, seg.length);
+                continue;
+            }
+
+            const FormatArg& arg = args[argIndex++];
+            if (!formatNative(out, seg, arg))
+            {
+                formatWithSpec(out, fmt, seg, arg);
+            }
+        }
+    }
+
+} // namespace openhedz::diagnostics::logging::Detail
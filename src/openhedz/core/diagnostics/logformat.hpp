@@ -0,0 +1,432 @@
+﻿#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+namespace openhedz::diagnostics::logging
+{
+    namespace Detail
+    {
+        enum class FormatArgKind : uint8_t
+        {
+            Invalid,
+            Signed,
+            Unsigned,
+            Double,
+            String,
+            WideString,
+            Pointer,
+        };
+
+        struct FormatArg
+        {
+            FormatArgKind kind;
+            uint8_t size;
+            union
+            {
+                int64_t i;
+                uint64_t u;
+                double d;
+                const char* s;
+                const wchar_t* ws;
+                const void* p;
+            };
+        };
+
+        template<typename T> constexpr FormatArgKind getFormatArgKind()
+        {
+            using TArg = std::decay_t<T>;
+            if constexpr (std::is_same_v<TArg, const char*> || std::is_same_v<TArg, char*>)
+                return FormatArgKind::String;
+            else if constexpr (std::is_same_v<TArg, const wchar_t*> || std::is_same_v<TArg, wchar_t*>)
+                return FormatArgKind::WideString;
+            else if constexpr (std::is_pointer_v<TArg> || std::is_null_pointer_v<TArg>)
+                return FormatArgKind::Pointer;
+            else if constexpr (std::is_floating_point_v<TArg>)
+                return FormatArgKind::Double;
+            else if constexpr (std::is_enum_v<TArg>)
+                return std::is_signed_v<std::underlying_type_t<TArg>> ? FormatArgKind::Signed : FormatArgKind::Unsigned;
+            else if constexpr (std::is_integral_v<TArg>)
+                return std::is_signed_v<TArg> ? FormatArgKind::Signed : FormatArgKind::Unsigned;
+            else
+                return FormatArgKind::Invalid;
+        }
+
+        // What the validation knows of an argument, integers also have to match the length modifier in size.
+        struct FormatArgType
+        {
+            FormatArgKind kind;
+            uint8_t size;
+        };
+
+        template<typename T> constexpr FormatArgType getFormatArgType()
+        {
+            using TArg = std::decay_t<T>;
+            return FormatArgType{ getFormatArgKind<TArg>(), static_cast<uint8_t>(sizeof(TArg)) };
+        }
+
+        template<typename T> inline FormatArg makeFormatArg(const T& v)
+        {
+            using TArg = std::decay_t<T>;
+            constexpr FormatArgKind kind = getFormatArgKind<TArg>();
+
+            FormatArg arg{};
+            arg.kind = kind;
+            arg.size = static_cast<uint8_t>(sizeof(TArg));
+            if constexpr (kind == FormatArgKind::String)
+                arg.s = v;
+            else if constexpr (kind == FormatArgKind::WideString)
+                arg.ws = v;
+            else if constexpr (kind == FormatArgKind::Pointer)
+                arg.p = v;
+            else if constexpr (kind == FormatArgKind::Double)
+                arg.d = static_cast<double>(v);
+            else if constexpr (kind == FormatArgKind::Signed)
+                arg.i = static_cast<int64_t>(v);
+            else if constexpr (kind == FormatArgKind::Unsigned)
+                arg.u = static_cast<uint64_t>(v);
+            return arg;
+        }
+
+        // Literal text when conversion is 0, otherwise a conversion where the text is the flags, width
+        // and precision between the '%' and the length modifier.
+        struct FormatSegment
+        {
+            uint16_t offset;
+            uint16_t length;
+            char conversion;
+            bool wide;
+            // Only '-' and '0' flags and a constant width and precision, applied without snprintf.
+            bool simple;
+            bool leftAlign;
+            bool zeroPad;
+            uint8_t width;
+            int16_t precision;
+            // 2 for 'h' and 1 for 'hh', integers are truncated to it. 0 keeps the size of the argument.
+            uint8_t intSize;
+            // Size of the integer the length modifier asks for, 0 for int or smaller.
+            uint8_t argSize;
+        };
+
+        constexpr FormatSegment makeLiteralSegment(size_t offset, size_t length)
+        {
+            return FormatSegment{
+                static_cast<uint16_t>(offset), static_cast<uint16_t>(length), '\0', false, true, false, false, 0, -1, 0, 0
+            };
+        }
+
+        enum class FormatError
+        {
+            None,
+            Unsupported,
+            ArgumentCount,
+            ArgumentType,
+        };
+
+        constexpr bool isFormatFlag(char c)
+        {
+            return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+        }
+
+        constexpr bool isFormatDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        // Parses the conversion starting after a '%', returns the position after it.
+        constexpr size_t parseConversion(std::string_view fmt, size_t pos, FormatSegment& seg)
+        {
+            const size_t start = pos;
+            seg = makeLiteralSegment(start, 0);
+
+            for (; pos < fmt.size() && isFormatFlag(fmt[pos]); ++pos)
+            {
+                if (fmt[pos] == '-')
+                    seg.leftAlign = true;
+                else if (fmt[pos] == '0')
+                    seg.zeroPad = true;
+                else
+                    seg.simple = false;
+            }
+
+            size_t width = 0;
+            for (; pos < fmt.size() && isFormatDigit(fmt[pos]); ++pos)
+                width = width * 10 + static_cast<size_t>(fmt[pos] - '0');
+
+            size_t precision = 0;
+            bool hasPrecision = false;
+            if (pos < fmt.size() && fmt[pos] == '.')
+            {
+                hasPrecision = true;
+                for (++pos; pos < fmt.size() && isFormatDigit(fmt[pos]); ++pos)
+                    precision = precision * 10 + static_cast<size_t>(fmt[pos] - '0');
+            }
+
+            // Star width or precision, rejected by the validation.
+            for (; pos < fmt.size() && (isFormatDigit(fmt[pos]) || fmt[pos] == '.' || fmt[pos] == '*'); ++pos)
+                seg.simple = false;
+
+            if (width > 255 || precision > 255)
+                seg.simple = false;
+
+            seg.length = static_cast<uint16_t>(pos - start);
+            seg.width = static_cast<uint8_t>(width);
+            seg.precision = hasPrecision ? static_cast<int16_t>(precision) : int16_t(-1);
+
+            while (pos < fmt.size())
+            {
+                const char c = fmt[pos];
+                if (c == 'l' || c == 'w')
+                {
+                    seg.wide = true;
+                    if (c == 'l')
+                        seg.argSize = seg.argSize == sizeof(long) ? uint8_t(sizeof(long long)) : uint8_t(sizeof(long));
+                }
+                else if (c == 'h')
+                    seg.intSize = seg.intSize == 2 ? 1 : 2;
+                else if (c == 'I' && pos + 2 < fmt.size() && (fmt[pos + 1] == '3' || fmt[pos + 1] == '6'))
+                {
+                    seg.argSize = fmt[pos + 1] == '3' ? uint8_t(4) : uint8_t(8);
+                    pos += 2;
+                }
+                else if (c == 'L' || c == 'j')
+                    seg.argSize = 8;
+                else if (c == 'z' || c == 'I')
+                    seg.argSize = sizeof(size_t);
+                else if (c == 't')
+                    seg.argSize = sizeof(ptrdiff_t);
+                else
+                    break;
+                ++pos;
+            }
+
+            // A dangling '%' is reported as an unsupported conversion.
+            seg.conversion = pos < fmt.size() ? fmt[pos] : '%';
+            if (seg.conversion == 'S')
+            {
+                seg.conversion = 's';
+                seg.wide = true;
+            }
+            return pos + 1;
+        }
+
+        constexpr size_t countFormatSegments(std::string_view fmt)
+        {
+            size_t count = 0;
+            size_t pos = 0;
+            while (pos < fmt.size())
+            {
+                if (fmt[pos] != '%')
+                {
+                    while (pos < fmt.size() && fmt[pos] != '%')
+                        ++pos;
+                }
+                else if (pos + 1 < fmt.size() && fmt[pos + 1] == '%')
+                {
+                    pos += 2;
+                }
+                else
+                {
+                    FormatSegment seg{};
+                    pos = parseConversion(fmt, pos + 1, seg);
+                }
+                ++count;
+            }
+            return count;
+        }
+
+        template<size_t N> constexpr std::array<FormatSegment, N> parseFormatSegments(std::string_view fmt)
+        {
+            std::array<FormatSegment, N> segments{};
+            size_t index = 0;
+            size_t pos = 0;
+            while (pos < fmt.size() && index < N)
+            {
+                FormatSegment& seg = segments[index++];
+                if (fmt[pos] != '%')
+                {
+                    const size_t start = pos;
+                    while (pos < fmt.size() && fmt[pos] != '%')
+                        ++pos;
+                    seg = makeLiteralSegment(start, pos - start);
+                }
+                else if (pos + 1 < fmt.size() && fmt[pos + 1] == '%')
+                {
+                    seg = makeLiteralSegment(pos + 1, 1);
+                    pos += 2;
+                }
+                else
+                {
+                    pos = parseConversion(fmt, pos + 1, seg);
+                }
+            }
+            return segments;
+        }
+
+        constexpr bool isConversionSupported(char conversion)
+        {
+            return conversion != '\0' && std::string_view("diuxXocfFeEgGaAsp").find(conversion) != std::string_view::npos;
+        }
+
+        // Arguments up to the size of int are promoted to int, larger ones need the length modifier of their size.
+        constexpr bool isIntegerCompatible(const FormatSegment& seg, FormatArgType type)
+        {
+            if (type.kind != FormatArgKind::Signed && type.kind != FormatArgKind::Unsigned)
+                return false;
+            if (seg.argSize <= sizeof(int))
+                return type.size <= sizeof(int);
+            return type.size == seg.argSize;
+        }
+
+        constexpr bool isConversionCompatible(const FormatSegment& seg, FormatArgType type)
+        {
+            const FormatArgKind kind = type.kind;
+            switch (seg.conversion)
+            {
+                case 'd':
+                case 'i':
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                    return isIntegerCompatible(seg, type);
+                case 'c':
+                    return (kind == FormatArgKind::Signed || kind == FormatArgKind::Unsigned) && type.size <= sizeof(int);
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                    return kind == FormatArgKind::Double;
+                case 's':
+                    return kind == (seg.wide ? FormatArgKind::WideString : FormatArgKind::String);
+                case 'p':
+                    return kind == FormatArgKind::Pointer || kind == FormatArgKind::String
+                        || kind == FormatArgKind::WideString;
+                default:
+                    return false;
+            }
+        }
+
+        template<size_t N, typename... Args>
+        constexpr FormatError validateFormat(std::string_view fmt, const std::array<FormatSegment, N>& segments)
+        {
+            constexpr FormatArgType types[] = { getFormatArgType<Args>()..., FormatArgType{ FormatArgKind::Invalid, 0 } };
+            constexpr size_t argCount = sizeof...(Args);
+
+            size_t argIndex = 0;
+            for (const auto& seg : segments)
+            {
+                if (seg.conversion == '\0')
+                    continue;
+
+                // Star width or precision would need additional arguments.
+                for (size_t i = 0; i < seg.length; ++i)
+                {
+                    if (fmt[seg.offset + i] == '*')
+                        return FormatError::Unsupported;
+                }
+                if (!isConversionSupported(seg.conversion))
+                    return FormatError::Unsupported;
+
+                if (argIndex >= argCount)
+                    return FormatError::ArgumentCount;
+                if (!isConversionCompatible(seg, types[argIndex]))
+                    return FormatError::ArgumentType;
+                ++argIndex;
+            }
+            return argIndex == argCount ? FormatError::None : FormatError::ArgumentCount;
+        }
+
+        // Output of the formatter, spills to the heap only for long messages.
+        class FormatBuffer
+        {
+            char _local[256];
+            std::unique_ptr<char[]> _heap;
+            char* _data = _local;
+            size_t _size = 0;
+            size_t _capacity = sizeof(_local);
+
+        public:
+            void append(const char* str, size_t len);
+
+            void append(char c)
+            {
+                append(&c, 1);
+            }
+
+            const char* c_str()
+            {
+                append('\0');
+                --_size;
+                return _data;
+            }
+
+            size_t size() const
+            {
+                return _size;
+            }
+
+            void clear()
+            {
+                _size = 0;
+            }
+        };
+
+        void formatSegments(
+            const char* fmt, const FormatSegment* segments, size_t segmentCount, const FormatArg* args,
+            FormatBuffer& out);
+
+    } // namespace Detail
+
+    // Format string checked against the arguments at compile time, create it with LOG_FMT.
+    template<typename TProvider> struct FormatString
+    {
+        static constexpr std::string_view Text = TProvider::value();
+        static constexpr std::array<Detail::FormatSegment, Detail::countFormatSegments(Text)> Segments =
+            Detail::parseFormatSegments<Detail::countFormatSegments(Text)>(Text);
+
+        // Text without conversions, printed as is.
+        static constexpr bool IsLiteral = Segments.size() == 0
+            || (Segments.size() == 1 && Segments[0].conversion == '\0' && Segments[0].length == Text.size());
+
+        const char* c_str() const
+        {
+            return Text.data();
+        }
+
+        template<typename... Args> static constexpr void validate()
+        {
+            constexpr Detail::FormatError error = Detail::validateFormat<Segments.size(), Args...>(Text, Segments);
+            static_assert(error != Detail::FormatError::Unsupported, "Log format string uses an unsupported conversion");
+            static_assert(error != Detail::FormatError::ArgumentCount, "Log format string expects a different argument count");
+            static_assert(error != Detail::FormatError::ArgumentType, "Log format string does not match the argument types");
+        }
+
+        template<typename... Args> static void format(Detail::FormatBuffer& out, const Args&... args)
+        {
+            const Detail::FormatArg formatArgs[] = { Detail::makeFormatArg(args)..., Detail::FormatArg{} };
+            Detail::formatSegments(Text.data(), Segments.data(), Segments.size(), formatArgs, out);
+        }
+    };
+
+} // namespace openhedz::diagnostics::logging
+
+#define LOG_FMT(str)                                                                                                           \
+    [] {                                                                                                                       \
+        struct Provider                                                                                                        \
+        {                                                                                                                      \
+            static constexpr std::string_view value()                                                                          \
+            {                                                                                                                  \
+                return str;                                                                                                    \
+            }                                                                                                                  \
+        };                                                                                                                     \
+        return ::openhedz::diagnostics::logging::FormatString<Provider>{};                                                     \
+    }()
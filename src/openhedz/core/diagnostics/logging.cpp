@@ -1,8 +1,19 @@
 ﻿#include "logging.hpp"
 
+#include "logbatch.hpp"
+#include "logjson.hpp"
+#include "logmapped.hpp"
+#include "logqueue.hpp"
+#include "logrecorder.hpp"
+#include "logtimestamp.hpp"
+
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <ctime>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #if defined(_MSC_VER)
@@ -119,6 +130,28 @@ namespace openhedz::diagnostics::logging
         ColorCode _bgColor = ColorCode::BackgroundDefault;
         bool _freeConsole = false;
 
+        // Async mode, only set up when requested in the options.
+        static constexpr size_t kQueueSize = 4096;
+
+        std::unique_ptr<LogQueue> _queue;
+        OverflowPolicy _overflow = OverflowPolicy::Drop;
+        std::thread _writer;
+        std::mutex _writerMutex;
+        std::condition_variable _writerCv;
+        std::atomic<bool> _writerWaiting{ false };
+        std::atomic<bool> _stopWriter{ false };
+        // Sinks are only flushed by the writer, flush() waits until the writer got to its request.
+        std::condition_variable _flushedCv;
+        std::atomic<uint64_t> _flushRequests{ 0 };
+        std::atomic<uint64_t> _flushesDone{ 0 };
+        std::atomic<uint32_t> _dropped{ 0 };
+
+        std::unique_ptr<BinaryLog> _binary;
+        std::unique_ptr<LogBatch> _batch;
+        std::unique_ptr<MappedLogSink> _mapped;
+        std::unique_ptr<JsonLogSink> _json;
+        std::unique_ptr<FlightRecorder> _recorder;
+
     private:
         void CreateConsole()
         {
@@ -157,18 +190,144 @@ namespace openhedz::diagnostics::logging
             _freeConsole = true;
         }
 
+        uint64_t getElapsedUs() const
+        {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _start).count());
+        }
+
+        void drainQueue()
+        {
+            while (_queue->consume([this](const LogRecord& record) {
+                writeMsg(record.info, record.getText());
+            }))
+            {
+            }
+
+            const uint32_t dropped = _dropped.exchange(0);
+            if (dropped != 0)
+            {
+                char msg[64];
+                sprintf_s(msg, "Log queue full, dropped %u messages\n", dropped);
+                const MsgInfo info{ Detail::MsgType::Warning, nullptr, GetCurrentThreadId(), getElapsedUs() };
+                writeMsg(info, msg);
+            }
+        }
+
+        void flushSinks()
+        {
+            if (_batch)
+            {
+                _batch->flush();
+            }
+            else if (_mapped)
+            {
+                _mapped->flush();
+            }
+            else if (_fp != nullptr)
+            {
+                fflush(_fp);
+            }
+
+            if (_json)
+            {
+                _json->flush();
+            }
+        }
+
+        void writerThread()
+        {
+            while (!_stopWriter.load())
+            {
+                // Read before draining, everything queued before the request is written when the sinks are flushed.
+                const uint64_t flushRequests = _flushRequests.load();
+                drainQueue();
+
+                if (flushRequests != _flushesDone.load())
+                {
+                    flushSinks();
+
+                    std::lock_guard<std::mutex> lock(_writerMutex);
+                    _flushesDone = flushRequests;
+                    _flushedCv.notify_all();
+                }
+
+                std::unique_lock<std::mutex> lock(_writerMutex);
+                _writerWaiting = true;
+                if (_queue->empty() && !_stopWriter.load() && _flushRequests.load() == _flushesDone.load())
+                {
+                    // Producers do not take the lock when notifying, the timeout covers a missed wakeup.
+                    _writerCv.wait_for(lock, std::chrono::milliseconds(10));
+                }
+                _writerWaiting = false;
+            }
+            drainQueue();
+        }
+
+        void wakeWriter()
+        {
+            if (_writerWaiting.load(std::memory_order_relaxed))
+            {
+                _writerCv.notify_one();
+            }
+        }
+
+        void enqueueMsg(const MsgInfo& info, const char* txt)
+        {
+            while (!_queue->tryPush(info, txt))
+            {
+                if (_overflow == OverflowPolicy::Drop)
+                {
+                    _dropped++;
+                    return;
+                }
+                wakeWriter();
+                std::this_thread::yield();
+            }
+            wakeWriter();
+        }
+
+        void updateBinaryNeedsText()
+        {
+            _binaryNeedsText = TOpts::Console || !_sinks.empty() || _recorder != nullptr;
+        }
+
     public:
-        LogHandle(const std::string_view name = "")
+        LogHandle(const std::string_view name, const Options& opts)
             : _start(Clock::now())
         {
-            if (!name.empty())
+            if (!name.empty() && opts.Binary)
             {
                 std::string fileName(name);
-                if (fileName.find_first_of('.') == fileName.npos)
+                fileName = fileName.substr(0, fileName.find_first_of('.')) + ".blog";
+                _binary = std::make_unique<BinaryLog>(fileName);
+                _binaryLog = _binary.get();
+            }
+            else if (!name.empty())
+            {
+                if (opts.Mapped)
                 {
-                    fileName += ".txt";
+                    _mapped = std::make_unique<MappedLogSink>(name, opts.MappedSegmentSize, opts.MappedSegments);
+                    // The plain file is the fallback when not even the first segment can be created.
+                    if (!_mapped->isOpen())
+                    {
+                        _mapped.reset();
+                    }
+                }
+
+                if (!_mapped)
+                {
+                    std::string fileName(name);
+                    if (fileName.find_first_of('.') == fileName.npos)
+                    {
+                        fileName += ".txt";
+                    }
+                    _fp = _fsopen(fileName.c_str(), "wt", _SH_DENYWR);
+                    if (_fp != nullptr && opts.Batched)
+                    {
+                        _batch = std::make_unique<LogBatch>(_fp);
+                    }
                 }
-                _fp = _fsopen(fileName.c_str(), "wt", _SH_DENYWR);
             }
 
             if constexpr (TOpts::Console)
@@ -189,10 +348,45 @@ namespace openhedz::diagnostics::logging
                     SetConsoleMode(hOut, dwMode);
                 }
             }
+
+            if (!name.empty() && opts.Json)
+            {
+                std::string fileName(name);
+                fileName = fileName.substr(0, fileName.find_first_of('.')) + ".jsonl";
+                _json = std::make_unique<JsonLogSink>(fileName);
+                _sinks.push_back(_json.get());
+            }
+
+            if (opts.RecorderSize != 0)
+            {
+                _recorder = std::make_unique<FlightRecorder>(opts.RecorderSize);
+            }
+
+            if (opts.Async)
+            {
+                _queue = std::make_unique<LogQueue>(kQueueSize);
+                _overflow = opts.Overflow;
+                _writer = std::thread([this]() { writerThread(); });
+            }
+
+            updateBinaryNeedsText();
         }
 
         ~LogHandle()
         {
+            if (_queue)
+            {
+                _stopWriter = true;
+                _writerCv.notify_one();
+                if (_writer.joinable())
+                {
+                    _writer.join();
+                }
+                // The writer may have been terminated already when this runs during process exit.
+                drainQueue();
+            }
+
+            _batch.reset();
             if (_fp)
             {
                 fclose(_fp);
@@ -324,6 +518,7 @@ namespace openhedz::diagnostics::logging
         void addSink(ILogSink* sink) override
         {
             _sinks.push_back(sink);
+            updateBinaryNeedsText();
         }
 
         void removeSink(ILogSink* sink) override
@@ -333,32 +528,86 @@ namespace openhedz::diagnostics::logging
                 return;
 
             _sinks.erase(it);
+            updateBinaryNeedsText();
+        }
+
+        void flush() override
+        {
+            if (_binary)
+            {
+                _binary->flush();
+            }
+
+            if (_queue)
+            {
+                std::unique_lock<std::mutex> lock(_writerMutex);
+                const uint64_t request = ++_flushRequests;
+                _writerCv.notify_one();
+
+                const auto isFlushed = [&] { return _flushesDone.load() >= request; };
+                while (!_flushedCv.wait_for(lock, std::chrono::milliseconds(10), isFlushed))
+                {
+                    // The writer is gone when this runs during process exit, nothing else writes to the sinks then.
+                    if (WaitForSingleObject(_writer.native_handle(), 0) == WAIT_OBJECT_0)
+                    {
+                        lock.unlock();
+                        drainQueue();
+                        flushSinks();
+                        return;
+                    }
+                }
+                return;
+            }
+
+            flushSinks();
+        }
+
+        FlightRecorder* getRecorder() override
+        {
+            return _recorder.get();
         }
 
         ILogHandle& printMsg(Detail::MsgType type, const char* txt) override
         {
-            char timestamp[32] = { 0 };
+            MsgInfo info{ type, Detail::currentCategory, GetCurrentThreadId(), 0 };
+            if (TOpts::Timestamp || !_sinks.empty() || _recorder)
+            {
+                info.elapsedUs = getElapsedUs();
+            }
+
+            // Recorded before queueing, a crash must not lose what is still in the queue.
+            if (_recorder)
+            {
+                _recorder->record(info, txt);
+            }
+
+            if (_queue)
+            {
+                enqueueMsg(info, txt);
+                return *this;
+            }
+
+            writeMsg(info, txt);
+            return *this;
+        }
+
+        void writeMsg(const MsgInfo& info, const char* txt)
+        {
+            const Detail::MsgType type = info.type;
+            const char* timestamp = "";
 
             if constexpr (TOpts::Timestamp)
             {
                 if (type != Detail::MsgType::Logo)
                 {
-                    auto now = Clock::now();
-
-                    const uint64_t elapsed = static_cast<uint64_t>(
-                        std::chrono::duration_cast<std::chrono::milliseconds>(now - _start).count());
-                    const uint64_t secs = elapsed / 1000;
-                    const uint64_t ms = elapsed - (secs * 1000);
-                    const uint64_t mins = secs / 60;
-                    const uint64_t hrs = (mins / 60);
-
-                    sprintf_s(timestamp, "[%02llu:%02llu:%02llu:%03llu] ", hrs, mins % 60, secs % 60, ms);
+                    static thread_local TimestampCache timestampCache;
+                    timestamp = timestampCache.format(info.elapsedUs / 1000);
                 }
             }
 
             for (auto* sink : _sinks)
             {
-                sink->printMsg(type, txt);
+                sink->printRecord(info, txt);
             }
 
             if constexpr (TOpts::Console)
@@ -409,15 +658,41 @@ namespace openhedz::diagnostics::logging
                 }
             }
 
-            if (_fp != nullptr)
+            if (_batch)
+            {
+                _batch->append(timestamp, txt);
+            }
+            else if (_mapped)
+            {
+                _mapped->write(timestamp, txt);
+            }
+            else if (_fp != nullptr)
             {
                 print(_fp, "%s%s", timestamp, txt);
             }
-
-            return *this;
         }
     };
 
+    const char* getMsgTypeName(Detail::MsgType type)
+    {
+        switch (type)
+        {
+            case Detail::MsgType::Info:
+                return "info";
+            case Detail::MsgType::Warning:
+                return "warning";
+            case Detail::MsgType::Error:
+                return "error";
+            case Detail::MsgType::Echo:
+                return "echo";
+            case Detail::MsgType::Logo:
+                return "logo";
+            case Detail::MsgType::Highlight:
+                return "highlight";
+        }
+        return "unknown";
+    }
+
     ILogHandle& get()
     {
         if (!_globalLog)
@@ -430,12 +705,12 @@ namespace openhedz::diagnostics::logging
     static std::unique_ptr<ILogHandle> createImpl(std::string_view name, Options opts)
     {
         if (opts.Console && opts.Timestamp)
-            return std::make_unique<LogHandle<Detail::Options<true, true>>>(name);
+            return std::make_unique<LogHandle<Detail::Options<true, true>>>(name, opts);
         else if (!opts.Console && opts.Timestamp)
-            return std::make_unique<LogHandle<Detail::Options<false, true>>>(name);
+            return std::make_unique<LogHandle<Detail::Options<false, true>>>(name, opts);
         else if (opts.Console && !opts.Timestamp)
-            return std::make_unique<LogHandle<Detail::Options<true, false>>>(name);
-        return std::make_unique<LogHandle<Detail::Options<false, false>>>(name);
+            return std::make_unique<LogHandle<Detail::Options<true, false>>>(name, opts);
+        return std::make_unique<LogHandle<Detail::Options<false, false>>>(name, opts);
     }
 
     void init(std::string_view name, Options opts)
@@ -1,6 +1,12 @@
 ﻿#pragma once
 
+#include "logbinary.hpp"
+#include "logfilter.hpp"
+#include "logformat.hpp"
+
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -40,6 +46,29 @@ namespace openhedz::diagnostics::logging
             return v.data();
         }
 
+        // Name of the category the current thread is logging with, set by the category overloads.
+        inline thread_local const char* currentCategory = nullptr;
+
+        class CategoryScope
+        {
+            const char* _previous;
+
+        public:
+            explicit CategoryScope(Category category)
+                : _previous(currentCategory)
+            {
+                currentCategory = getCategoryName(category);
+            }
+
+            ~CategoryScope()
+            {
+                currentCategory = _previous;
+            }
+
+            CategoryScope(const CategoryScope&) = delete;
+            CategoryScope& operator=(const CategoryScope&) = delete;
+        };
+
         template<bool TConsole, bool TTimestamp> struct Options
         {
             static constexpr bool Console = TConsole;
@@ -69,22 +98,71 @@ namespace openhedz::diagnostics::logging
         BrightWhite,
     };
 
+    // What producers do when the async queue is full.
+    enum class OverflowPolicy
+    {
+        Drop,
+        Block,
+    };
+
     struct Options
     {
         bool Console;
         bool Timestamp;
+        // Messages are queued and written by a dedicated thread.
+        bool Async = false;
+        OverflowPolicy Overflow = OverflowPolicy::Drop;
+        // Messages are recorded unformatted to a .blog file instead of the text file, see logdecode. They are
+        // only formatted when the console, a sink or the recorder is in use.
+        bool Binary = false;
+        // File output is staged per thread and written in batches.
+        bool Batched = false;
+        // File output goes to memory mapped segments of MappedSegmentSize, keeping the last MappedSegments.
+        bool Mapped = false;
+        size_t MappedSegmentSize = 4 * 1024 * 1024;
+        uint32_t MappedSegments = 4;
+        // Messages are also written as JSON lines with their metadata to a .jsonl file.
+        bool Json = false;
+        // Keeps the last RecorderSize messages in memory to dump after a crash, see FlightRecorder.
+        uint32_t RecorderSize = 0;
+    };
+
+    // Everything known about a message besides its text.
+    struct MsgInfo
+    {
+        Detail::MsgType type;
+        // Name of the category, nullptr for messages logged without one.
+        const char* category;
+        uint32_t threadId;
+        // Monotonic, microseconds since the log was created.
+        uint64_t elapsedUs;
     };
 
+    const char* getMsgTypeName(Detail::MsgType type);
+
+    class FlightRecorder;
+
     class ILogSink
     {
     public:
         virtual ~ILogSink() = default;
 
         virtual void printMsg(Detail::MsgType type, const char* txt) = 0;
+
+        // Sinks that want the metadata override this, the default only passes on the text.
+        virtual void printRecord(const MsgInfo& info, const char* txt)
+        {
+            printMsg(info.type, txt);
+        }
     };
 
     class ILogHandle
     {
+    protected:
+        BinaryLog* _binaryLog = nullptr;
+        // The binary log only replaces the text file, the console, sinks and the recorder still take text.
+        bool _binaryNeedsText = false;
+
     public:
         virtual ~ILogHandle() = default;
 
@@ -96,46 +174,88 @@ namespace openhedz::diagnostics::logging
         virtual void addSink(ILogSink* sink) = 0;
         virtual void removeSink(ILogSink* sink) = 0;
 
+        // Blocks until all queued messages are written.
+        virtual void flush() = 0;
+
+        // Null unless Options::RecorderSize was set.
+        virtual FlightRecorder* getRecorder() = 0;
+
         template<typename... Args> ILogHandle& info(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Info, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& info(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Info, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> ILogHandle& warn(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Warning, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& warn(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Warning, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> ILogHandle& err(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Error, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& err(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Error, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> ILogHandle& echo(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Echo, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& echo(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Echo, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> ILogHandle& logo(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Logo, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& logo(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Logo, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> ILogHandle& highlight(const char* fmt, Args&&... args)
         {
             formatMsg(Detail::MsgType::Highlight, fmt, std::forward<Args&&>(args)...);
             return *this;
         }
 
+        template<typename TProvider, typename... Args> ILogHandle& highlight(FormatString<TProvider> fmt, Args&&... args)
+        {
+            formatMsg(Detail::MsgType::Highlight, fmt, std::forward<Args&&>(args)...);
+            return *this;
+        }
+
         template<typename... Args> bool guard(bool f, const char* expr, const char* file, int line)
         {
             if (!f)
-                formatMsg(Detail::MsgType::Error, "Guard (%s:%d): %s\n", file, line, expr);
+                formatMsg(Detail::MsgType::Error, LOG_FMT("Guard (%s:%d): %s\n"), file, line, expr);
             return f;
         }
 
@@ -171,6 +291,13 @@ namespace openhedz::diagnostics::logging
 #pragma warning(disable : 4774)
         template<typename... Args> ILogHandle& formatMsg(Detail::MsgType type, const char* fmt, Args&&... args)
         {
+            if (_binaryLog != nullptr)
+            {
+                _binaryLog->write(type, fmt, Detail::argumentHandler(args)...);
+                if (!_binaryNeedsText)
+                    return *this;
+            }
+
             char buffer[128];
             // Use local buffer first, for 90% of the time this is enough space.
             int neededLength = snprintf(buffer, sizeof(buffer), fmt, Detail::argumentHandler(args)...);
@@ -188,6 +315,32 @@ namespace openhedz::diagnostics::logging
             return printMsg(type, buffer);
         }
 #pragma warning(pop)
+
+        // Format string checked at compile time, formats from the precomputed segments without parsing.
+        template<typename TProvider, typename... Args>
+        ILogHandle& formatMsg(Detail::MsgType type, FormatString<TProvider> fmt, Args&&... args)
+        {
+            using TFormat = FormatString<TProvider>;
+            TFormat::template validate<decltype(Detail::argumentHandler(args))...>();
+
+            if (_binaryLog != nullptr)
+            {
+                _binaryLog->write(type, fmt.c_str(), Detail::argumentHandler(args)...);
+                if (!_binaryNeedsText)
+                    return *this;
+            }
+
+            if constexpr (TFormat::IsLiteral)
+            {
+                return printMsg(type, fmt.c_str());
+            }
+            else
+            {
+                Detail::FormatBuffer buffer;
+                TFormat::format(buffer, Detail::argumentHandler(args)...);
+                return printMsg(type, buffer.c_str());
+            }
+        }
     };
 
     void init(Options opts = { true, false });
@@ -199,6 +352,11 @@ namespace openhedz::diagnostics::logging
     // Global log handle.
     ILogHandle& get();
 
+    inline void flush()
+    {
+        get().flush();
+    }
+
     inline ILogHandle& setBgColor(ConsoleColor color)
     {
         return get().setBgColor(color);
@@ -214,31 +372,98 @@ namespace openhedz::diagnostics::logging
         return get().info(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& info(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().info(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> ILogHandle& warn(const char* fmt, TArgs&&... args)
     {
         return get().warn(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& warn(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().warn(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> ILogHandle& err(const char* fmt, TArgs&&... args)
     {
         return get().err(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& err(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().err(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> ILogHandle& echo(const char* fmt, TArgs&&... args)
     {
         return get().echo(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& echo(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().echo(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> ILogHandle& logo(const char* fmt, TArgs&&... args)
     {
         return get().logo(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& logo(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().logo(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> ILogHandle& highlight(const char* fmt, TArgs&&... args)
     {
         get().highlight(fmt, std::forward<TArgs&&>(args)...);
     }
 
+    template<typename TProvider, typename... TArgs> ILogHandle& highlight(FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        return get().highlight(fmt, std::forward<TArgs&&>(args)...);
+    }
+
+    // Filtered by the level of the category before anything is formatted.
+    template<typename TProvider, typename... TArgs>
+    ILogHandle& err(Category category, FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        if (!isEnabled(category, Level::Error))
+            return get();
+        Detail::CategoryScope scope(category);
+        return get().err(fmt, std::forward<TArgs&&>(args)...);
+    }
+
+    template<typename TProvider, typename... TArgs>
+    ILogHandle& warn(Category category, FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        if (!isEnabled(category, Level::Warning))
+            return get();
+        Detail::CategoryScope scope(category);
+        return get().warn(fmt, std::forward<TArgs&&>(args)...);
+    }
+
+    template<typename TProvider, typename... TArgs>
+    ILogHandle& echo(Category category, FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        if (!isEnabled(category, Level::Info))
+            return get();
+        Detail::CategoryScope scope(category);
+        return get().echo(fmt, std::forward<TArgs&&>(args)...);
+    }
+
+    template<typename TProvider, typename... TArgs>
+    ILogHandle& verbose(Category category, FormatString<TProvider> fmt, TArgs&&... args)
+    {
+        if (!isEnabled(category, Level::Verbose))
+            return get();
+        Detail::CategoryScope scope(category);
+        return get().echo(fmt, std::forward<TArgs&&>(args)...);
+    }
+
     template<typename... TArgs> bool guard(bool f, const char* expr, const char* file, int line)
     {
         return get().guard(f, expr, file, line);
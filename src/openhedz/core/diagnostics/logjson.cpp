@@ -0,0 +1,154 @@
+﻿#include "logjson.hpp"
+
+#include <cstring>
+#include <string>
+
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4996) // Secure CRT warnings, don't care.
+#endif
+
+namespace openhedz::diagnostics::logging
+{
+    static constexpr size_t kInitialBufferSize = 1024;
+
+    // Characters that can not appear in a JSON string as they are. Bytes above 0x7F are escaped as
+    // well, the text is not guaranteed to be UTF-8 and the file has to stay valid JSON.
+    static bool needsEscape(unsigned char c)
+    {
+        return c < 0x20 || c >= 0x80 || c == '"' || c == '\\';
+    }
+
+    JsonLogSink::JsonLogSink(std::string_view fileName)
+    {
+        _fp = _fsopen(std::string(fileName).c_str(), "wb", _SH_DENYWR);
+        _buffer.reserve(kInitialBufferSize);
+    }
+
+    JsonLogSink::~JsonLogSink()
+    {
+        if (_fp != nullptr)
+        {
+            fclose(_fp);
+        }
+    }
+
+    void JsonLogSink::printMsg(Detail::MsgType type, const char* txt)
+    {
+        printRecord(MsgInfo{ type, nullptr, 0, 0 }, txt);
+    }
+
+    void JsonLogSink::printRecord(const MsgInfo& info, const char* txt)
+    {
+        if (_fp == nullptr)
+            return;
+
+        size_t len = strlen(txt);
+        // Messages carry their own line break, a record is a line already.
+        while (len > 0 && (txt[len - 1] == '\n' || txt[len - 1] == '\r'))
+        {
+            len--;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _buffer.clear();
+        append("{\"ts\":", 6);
+        appendNumber(info.elapsedUs);
+
+        const char* level = getMsgTypeName(info.type);
+        append(",\"level\":\"", 10);
+        append(level, strlen(level));
+
+        append("\",\"thread\":", 11);
+        appendNumber(info.threadId);
+
+        if (info.category != nullptr)
+        {
+            append(",\"category\":\"", 13);
+            append(info.category, strlen(info.category));
+            append("\"", 1);
+        }
+
+        append(",\"msg\":\"", 8);
+        appendEscaped(txt, len);
+        append("\"}\n", 3);
+
+        fwrite(_buffer.data(), 1, _buffer.size(), _fp);
+    }
+
+    void JsonLogSink::flush()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fp != nullptr)
+        {
+            fflush(_fp);
+        }
+    }
+
+    void JsonLogSink::append(const char* str, size_t len)
+    {
+        _buffer.insert(_buffer.end(), str, str + len);
+    }
+
+    void JsonLogSink::appendNumber(uint64_t value)
+    {
+        char digits[20];
+        size_t count = 0;
+        do
+        {
+            digits[sizeof(digits) - 1 - count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        append(digits + sizeof(digits) - count, count);
+    }
+
+    void JsonLogSink::appendEscaped(const char* txt, size_t len)
+    {
+        static constexpr char kHex[] = "0123456789abcdef";
+
+        size_t start = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            const auto c = static_cast<unsigned char>(txt[i]);
+            if (!needsEscape(c))
+                continue;
+
+            // Copy the run of plain characters in one go.
+            append(txt + start, i - start);
+            start = i + 1;
+
+            switch (c)
+            {
+                case '"':
+                    append("\\\"", 2);
+                    break;
+                case '\\':
+                    append("\\\\", 2);
+                    break;
+                case '\n':
+                    append("\\n", 2);
+                    break;
+                case '\r':
+                    append("\\r", 2);
+                    break;
+                case '\t':
+                    append("\\t", 2);
+                    break;
+                default:
+                {
+                    const char escaped[6] = { '\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF] };
+                    append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+        }
+        append(txt + start, len - start);
+    }
+
+} // namespace openhedz::diagnostics::logging
+
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include "logging.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace openhedz::diagnostics::logging
+{
+    // Writes one JSON object per line with the metadata of the message:
+    //   {"ts":1234,"level":"warning","thread":5678,"category":"hooks","msg":"..."}
+    // ts is in microseconds since the log was created, category is omitted for messages without one.
+    // Lines are built in a buffer that is reused, a record allocates nothing once the buffer has grown.
+    class JsonLogSink final : public ILogSink
+    {
+        FILE* _fp = nullptr;
+        std::mutex _mutex;
+        std::vector<char> _buffer;
+
+    public:
+        explicit JsonLogSink(std::string_view fileName);
+        ~JsonLogSink() override;
+
+        JsonLogSink(const JsonLogSink&) = delete;
+        JsonLogSink& operator=(const JsonLogSink&) = delete;
+
+        void printMsg(Detail::MsgType type, const char* txt) override;
+        void printRecord(const MsgInfo& info, const char* txt) override;
+
+        void flush();
+
+    private:
+        void append(const char* str, size_t len);
+        void appendNumber(uint64_t value);
+        void appendEscaped(const char* txt, size_t len);
+    };
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,217 @@
+﻿#include "logmapped.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+
+namespace openhedz::diagnostics::logging
+{
+    MappedLogSink::MappedLogSink(std::string_view fileName, size_t segmentSize, uint32_t maxSegments)
+        : _segmentSize(segmentSize)
+        , _maxSegments(maxSegments > 0 ? maxSegments : 1)
+    {
+        const size_t dot = fileName.find_last_of('.');
+        if (dot == fileName.npos)
+        {
+            _stem = fileName;
+            _extension = ".txt";
+        }
+        else
+        {
+            _stem = fileName.substr(0, dot);
+            _extension = fileName.substr(dot);
+        }
+
+        removeSegments();
+        openSegment();
+    }
+
+    MappedLogSink::~MappedLogSink()
+    {
+        closeSegment();
+    }
+
+    std::string MappedLogSink::getSegmentName(uint32_t index) const
+    {
+        return _stem + "." + std::to_string(index) + _extension;
+    }
+
+    // True for "<stem>.<digits><extension>", the pattern also matches other files next to the log such as
+    // openhedz.crash.log and openhedz.recorder.log that have to survive a restart.
+    static bool isSegmentFileName(std::string_view name, std::string_view stem, std::string_view extension)
+    {
+        if (name.size() <= stem.size() + 1 + extension.size() || name.substr(0, stem.size()) != stem
+            || name[stem.size()] != '.' || name.substr(name.size() - extension.size()) != extension)
+            return false;
+
+        const std::string_view index = name.substr(stem.size() + 1, name.size() - stem.size() - 1 - extension.size());
+        return std::all_of(index.begin(), index.end(), [](char c) { return c >= '0' && c <= '9'; });
+    }
+
+    void MappedLogSink::removeSegments()
+    {
+        const std::string pattern = _stem + ".*" + _extension;
+
+        WIN32_FIND_DATAA findData{};
+        HANDLE hFind = FindFirstFileA(pattern.c_str(), &findData);
+        if (hFind == INVALID_HANDLE_VALUE)
+            return;
+
+        // The pattern is relative to the directory of the stem.
+        const size_t slash = _stem.find_last_of("\\/");
+        const std::string dir = slash == _stem.npos ? std::string() : _stem.substr(0, slash + 1);
+        const std::string_view stemName = std::string_view(_stem).substr(slash == _stem.npos ? 0 : slash + 1);
+        do
+        {
+            if (isSegmentFileName(findData.cFileName, stemName, _extension))
+                DeleteFileA((dir + findData.cFileName).c_str());
+        } while (FindNextFileA(hFind, &findData));
+
+        FindClose(hFind);
+    }
+
+    // Runs with the mutex held, logging the failure would come back into this sink. Reported once until
+    // a segment opens again.
+    void MappedLogSink::reportFailure(const std::string& name)
+    {
+        const DWORD error = GetLastError();
+        if (_failureReported)
+            return;
+        _failureReported = true;
+
+        char msg[512];
+        snprintf(
+            msg, sizeof(msg), "Unable to create log segment %s (error %lu)\n", name.c_str(), static_cast<unsigned long>(error));
+        OutputDebugStringA(msg);
+        fputs(msg, stderr);
+    }
+
+    bool MappedLogSink::openSegment()
+    {
+        const std::string name = getSegmentName(_segment);
+
+        HANDLE hFile = CreateFileA(
+            name.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            reportFailure(name);
+            return false;
+        }
+
+        const uint64_t size = _segmentSize;
+        HANDLE hMapping = CreateFileMappingA(
+            hFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+        if (hMapping == nullptr)
+        {
+            reportFailure(name);
+            CloseHandle(hFile);
+            return false;
+        }
+
+        void* view = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, _segmentSize);
+        if (view == nullptr)
+        {
+            reportFailure(name);
+            CloseHandle(hMapping);
+            CloseHandle(hFile);
+            return false;
+        }
+
+        _file = hFile;
+        _mapping = hMapping;
+        _view = static_cast<char*>(view);
+        _used = 0;
+        _failureReported = false;
+
+        if (_segment >= _maxSegments)
+        {
+            DeleteFileA(getSegmentName(_segment - _maxSegments).c_str());
+        }
+        return true;
+    }
+
+    void MappedLogSink::closeSegment()
+    {
+        if (_view == nullptr)
+            return;
+
+        UnmapViewOfFile(_view);
+        CloseHandle(_mapping);
+
+        // Drop the unused tail so the file ends with the last record.
+        LARGE_INTEGER end{};
+        end.QuadPart = static_cast<LONGLONG>(_used);
+        SetFilePointerEx(_file, end, nullptr, FILE_BEGIN);
+        SetEndOfFile(_file);
+        CloseHandle(_file);
+
+        _view = nullptr;
+        _mapping = nullptr;
+        _file = nullptr;
+        _used = 0;
+    }
+
+    void MappedLogSink::rotate()
+    {
+        closeSegment();
+        _segment++;
+        openSegment();
+    }
+
+    void MappedLogSink::append(const char* prefix, size_t prefixLen, const char* txt, size_t txtLen)
+    {
+        // Records are not split between segments, records larger than a segment are truncated.
+        if (_used > 0 && _used + prefixLen + txtLen > _segmentSize)
+        {
+            rotate();
+        }
+        // The segment failed to open before, try again.
+        if (_view == nullptr && !openSegment())
+            return;
+
+        if (prefixLen > _segmentSize - _used)
+            prefixLen = _segmentSize - _used;
+        std::memcpy(_view + _used, prefix, prefixLen);
+        _used += prefixLen;
+
+        if (txtLen > _segmentSize - _used)
+            txtLen = _segmentSize - _used;
+        std::memcpy(_view + _used, txt, txtLen);
+        _used += txtLen;
+    }
+
+    void MappedLogSink::write(const char* prefix, const char* txt)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        append(prefix, strlen(prefix), txt, strlen(txt));
+    }
+
+    void MappedLogSink::printMsg(Detail::MsgType, const char* txt)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        append("", 0, txt, strlen(txt));
+    }
+
+    bool MappedLogSink::isOpen()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _view != nullptr;
+    }
+
+    void MappedLogSink::flush()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_view != nullptr)
+        {
+            FlushViewOfFile(_view, _used);
+        }
+    }
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include "logging.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace openhedz::diagnostics::logging
+{
+    // Writes into a memory mapped file of fixed size, rotating to a new segment when it is full and
+    // keeping the last segments. Records are in the mapping as soon as they are written so they
+    // survive a crash of the process.
+    class MappedLogSink final : public ILogSink
+    {
+        std::string _stem;
+        std::string _extension;
+        size_t _segmentSize;
+        uint32_t _maxSegments;
+
+        std::mutex _mutex;
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+        char* _view = nullptr;
+        size_t _used = 0;
+        uint32_t _segment = 0;
+        bool _failureReported = false;
+
+    public:
+        // Segments are named <stem>.<index><extension>, segments of a previous session are removed.
+        MappedLogSink(std::string_view fileName, size_t segmentSize, uint32_t maxSegments);
+        ~MappedLogSink() override;
+
+        MappedLogSink(const MappedLogSink&) = delete;
+        MappedLogSink& operator=(const MappedLogSink&) = delete;
+
+        void printMsg(Detail::MsgType type, const char* txt) override;
+
+        void write(const char* prefix, const char* txt);
+
+        // False while no segment could be created, writes retry creating it.
+        bool isOpen();
+
+        // Starts writing the dirty pages to disk, only needed to survive a crash of the system.
+        void flush();
+
+    private:
+        std::string getSegmentName(uint32_t index) const;
+        void removeSegments();
+        void reportFailure(const std::string& name);
+        bool openSegment();
+        void closeSegment();
+        void rotate();
+        void append(const char* prefix, size_t prefixLen, const char* txt, size_t txtLen);
+    };
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,136 @@
+﻿#pragma once
+
+#include "logging.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace openhedz::diagnostics::logging
+{
+    struct LogRecord
+    {
+        static constexpr size_t kInlineTextSize = 232;
+
+        MsgInfo info;
+        // Set for messages that do not fit into text, owned by the record.
+        char* heapText;
+        char text[kInlineTextSize];
+
+        const char* getText() const
+        {
+            return heapText != nullptr ? heapText : text;
+        }
+    };
+
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4324) // Padding due to alignas is intended.
+#endif
+
+    // Bounded lock-free queue for multiple producers and a single consumer, each slot carries a
+    // sequence number that tells producers and the consumer who owns it.
+    class LogQueue
+    {
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            LogRecord record;
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        size_t _mask;
+
+        alignas(64) std::atomic<size_t> _head{ 0 };
+        alignas(64) std::atomic<size_t> _tail{ 0 };
+
+    public:
+        // Capacity must be a power of two.
+        explicit LogQueue(size_t capacity)
+            : _slots(new Slot[capacity])
+            , _mask(capacity - 1)
+        {
+            for (size_t i = 0; i < capacity; ++i)
+            {
+                _slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool tryPush(const MsgInfo& info, const char* txt)
+        {
+            size_t pos = _head.load(std::memory_order_relaxed);
+
+            Slot* slot;
+            for (;;)
+            {
+                slot = &_slots[pos & _mask];
+
+                const size_t seq = slot->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // Consumer has not released the slot yet, queue is full.
+                    return false;
+                }
+                else
+                {
+                    pos = _head.load(std::memory_order_relaxed);
+                }
+            }
+
+            LogRecord& record = slot->record;
+            record.info = info;
+            record.heapText = nullptr;
+
+            const size_t len = std::strlen(txt);
+            if (len < LogRecord::kInlineTextSize)
+            {
+                std::memcpy(record.text, txt, len + 1);
+            }
+            else
+            {
+                record.heapText = new char[len + 1];
+                std::memcpy(record.heapText, txt, len + 1);
+            }
+
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Calls f with the oldest record, returns false if the queue is empty. Only one thread may consume.
+        template<typename F> bool consume(F&& f)
+        {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+
+            Slot& slot = _slots[tail & _mask];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+                return false;
+
+            f(static_cast<const LogRecord&>(slot.record));
+
+            delete[] slot.record.heapText;
+            slot.record.heapText = nullptr;
+
+            slot.sequence.store(tail + _mask + 1, std::memory_order_release);
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+        }
+    };
+
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
+
+} // namespace openhedz::diagnostics::logging
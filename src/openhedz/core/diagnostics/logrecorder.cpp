@@ -0,0 +1,256 @@
+﻿#include "logrecorder.hpp"
+
+#include "logtimestamp.hpp"
+
+#include <cstring>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+
+namespace openhedz::diagnostics::logging
+{
+    // Collects the output on the stack and writes it in large chunks, nothing here may touch the heap
+    // or the CRT as the process state is unknown when dumping from the exception filter.
+    class DumpWriter
+    {
+        HANDLE _file;
+        size_t _used = 0;
+        char _buffer[4096];
+
+    public:
+        explicit DumpWriter(HANDLE file)
+            : _file(file)
+        {
+        }
+
+        ~DumpWriter()
+        {
+            flush();
+        }
+
+        void put(const char* str, size_t len)
+        {
+            while (len > 0)
+            {
+                if (_used == sizeof(_buffer))
+                    flush();
+
+                const size_t count = len < sizeof(_buffer) - _used ? len : sizeof(_buffer) - _used;
+                memcpy(_buffer + _used, str, count);
+                _used += count;
+                str += count;
+                len -= count;
+            }
+        }
+
+        void put(const char* str)
+        {
+            put(str, strlen(str));
+        }
+
+        void putNumber(uint64_t value)
+        {
+            char digits[20];
+            size_t count = 0;
+            do
+            {
+                digits[sizeof(digits) - 1 - count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+
+            put(digits + sizeof(digits) - count, count);
+        }
+
+        void flush()
+        {
+            DWORD written = 0;
+            if (_used > 0)
+                WriteFile(_file, _buffer, static_cast<DWORD>(_used), &written, nullptr);
+            _used = 0;
+        }
+    };
+
+    static FlightRecorder* _crashRecorder = nullptr;
+    static char _crashFileName[MAX_PATH];
+    static LPTOP_LEVEL_EXCEPTION_FILTER _previousFilter = nullptr;
+    static FlightRecorder::AddressResolver _crashResolver = nullptr;
+
+    // Appends to a fixed buffer without the CRT, truncates at the end of the buffer.
+    template<size_t N> static void appendText(char (&buffer)[N], size_t& used, const char* str)
+    {
+        while (*str != '\0' && used + 1 < N)
+        {
+            buffer[used++] = *str++;
+        }
+        buffer[used] = '\0';
+    }
+
+    template<size_t N> static void appendHex(char (&buffer)[N], size_t& used, uint32_t value)
+    {
+        static constexpr char kHex[] = "0123456789ABCDEF";
+
+        char digits[9]{};
+        for (int i = 7; i >= 0; --i)
+        {
+            digits[i] = kHex[value & 0xF];
+            value >>= 4;
+        }
+        appendText(buffer, used, digits);
+    }
+
+    static LONG WINAPI crashFilter(EXCEPTION_POINTERS* exceptionInfo)
+    {
+        if (_crashRecorder != nullptr)
+        {
+            const EXCEPTION_RECORD* record = exceptionInfo->ExceptionRecord;
+            const auto address = reinterpret_cast<uintptr_t>(record->ExceptionAddress);
+
+            char header[512];
+            size_t used = 0;
+            appendText(header, used, "Unhandled exception 0x");
+            appendHex(header, used, static_cast<uint32_t>(record->ExceptionCode));
+            appendText(header, used, " at 0x");
+            appendHex(header, used, static_cast<uint32_t>(address));
+
+            char location[256];
+            if (_crashResolver != nullptr && _crashResolver(address, location, sizeof(location)))
+            {
+                appendText(header, used, " (");
+                appendText(header, used, location);
+                appendText(header, used, ")");
+            }
+
+            _crashRecorder->dump(_crashFileName, header);
+        }
+
+        if (_previousFilter != nullptr)
+            return _previousFilter(exceptionInfo);
+
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    FlightRecorder::FlightRecorder(uint32_t capacity)
+    {
+        uint64_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        _slots.reset(new Slot[static_cast<size_t>(size)]);
+        _mask = size - 1;
+    }
+
+    FlightRecorder::~FlightRecorder()
+    {
+        if (_crashRecorder == this)
+        {
+            _crashRecorder = nullptr;
+        }
+    }
+
+    void FlightRecorder::record(const MsgInfo& info, const char* txt)
+    {
+        const uint64_t pos = _head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = _slots[static_cast<size_t>(pos & _mask)];
+
+        // A writer that is a full lap behind must neither overwrite a newer record nor interleave with
+        // one still in progress, the record is dropped instead.
+        uint64_t seq = slot.sequence.load(std::memory_order_relaxed);
+        if ((seq & 1) != 0 || seq > pos * 2)
+            return;
+        if (!slot.sequence.compare_exchange_strong(seq, pos * 2 + 1, std::memory_order_relaxed))
+            return;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        size_t len = strlen(txt);
+        if (len > kMaxTextSize)
+        {
+            len = kMaxTextSize;
+        }
+
+        slot.info = info;
+        slot.length = static_cast<uint32_t>(len);
+        memcpy(slot.text, txt, len);
+
+        slot.sequence.store(pos * 2 + 2, std::memory_order_release);
+    }
+
+    bool FlightRecorder::dump(const char* fileName, const char* header) const
+    {
+        HANDLE file = CreateFileA(
+            fileName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        {
+            DumpWriter writer(file);
+            TimestampCache timestamp;
+
+            if (header != nullptr)
+            {
+                writer.put(header);
+                writer.put("\r\n");
+            }
+
+            const uint64_t head = _head.load(std::memory_order_acquire);
+            const uint64_t capacity = _mask + 1;
+            for (uint64_t pos = head > capacity ? head - capacity : 0; pos < head; ++pos)
+            {
+                const Slot& slot = _slots[static_cast<size_t>(pos & _mask)];
+
+                const uint64_t seq = slot.sequence.load(std::memory_order_acquire);
+                if (seq != pos * 2 + 2)
+                    continue;
+
+                MsgInfo info = slot.info;
+                uint32_t length = slot.length;
+                char text[kMaxTextSize];
+                memcpy(text, slot.text, length <= kMaxTextSize ? length : kMaxTextSize);
+
+                // Overwritten while copying.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != seq || length > kMaxTextSize)
+                    continue;
+
+                while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+                {
+                    length--;
+                }
+
+                writer.put(timestamp.format(info.elapsedUs / 1000));
+                writer.put(getMsgTypeName(info.type));
+                writer.put(" [");
+                writer.putNumber(info.threadId);
+                writer.put("] ");
+                if (info.category != nullptr)
+                {
+                    writer.put(info.category);
+                    writer.put(": ");
+                }
+                writer.put(text, length);
+                writer.put("\r\n");
+            }
+        }
+
+        CloseHandle(file);
+        return true;
+    }
+
+    void FlightRecorder::installCrashHandler(const char* fileName, AddressResolver resolver)
+    {
+        strncpy_s(_crashFileName, fileName, _TRUNCATE);
+        _crashRecorder = this;
+        _crashResolver = resolver;
+
+        LPTOP_LEVEL_EXCEPTION_FILTER previous = SetUnhandledExceptionFilter(crashFilter);
+        if (previous != crashFilter)
+        {
+            _previousFilter = previous;
+        }
+    }
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "logging.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace openhedz::diagnostics::logging
+{
+    // Keeps the most recent messages in a fixed ring in memory so they can be written out after a crash,
+    // independent of what the other outputs had buffered. Recording takes no lock and allocates nothing,
+    // dumping only uses the stack and the Win32 file API so it is usable from an exception filter.
+    class FlightRecorder
+    {
+    public:
+        static constexpr size_t kMaxTextSize = 224;
+
+    private:
+        struct Slot
+        {
+            // pos * 2 + 1 while the record at pos is written, pos * 2 + 2 once it is complete.
+            std::atomic<uint64_t> sequence{ 0 };
+            MsgInfo info;
+            uint32_t length;
+            char text[kMaxTextSize];
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        uint64_t _mask;
+        alignas(64) std::atomic<uint64_t> _head{ 0 };
+
+    public:
+        // Capacity is rounded up to a power of two.
+        explicit FlightRecorder(uint32_t capacity);
+        ~FlightRecorder();
+
+        FlightRecorder(const FlightRecorder&) = delete;
+        FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+        // Longer messages are truncated.
+        void record(const MsgInfo& info, const char* txt);
+
+        // Writes the header line if given and then the recorded messages from oldest to newest, messages
+        // that are being overwritten while dumping are skipped.
+        bool dump(const char* fileName, const char* header = nullptr) const;
+
+        // Names the code at address for the crash report, returns false when it can not. Called from the
+        // exception filter so it must not allocate.
+        using AddressResolver = bool (*)(uintptr_t address, char* buffer, size_t size);
+
+        // Dumps to fileName when the process dies from an unhandled exception, the previous filter is
+        // still called afterwards. Only one recorder can be installed.
+        void installCrashHandler(const char* fileName, AddressResolver resolver = nullptr);
+    };
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace openhedz::diagnostics::logging
+{
+    // Formats the "[hh:mm:ss:mmm] " message prefix, keeps the last result so messages within the same
+    // millisecond reuse it and messages within the same second only rewrite the milliseconds.
+    class TimestampCache
+    {
+        static constexpr uint64_t kInvalid = ~uint64_t(0);
+
+        uint64_t _ms = kInvalid;
+        uint64_t _secs = kInvalid;
+        size_t _length = 0;
+        char _text[32]{};
+
+        static void writeDigits(char* dst, uint64_t value, size_t count)
+        {
+            for (size_t i = count; i > 0; --i)
+            {
+                dst[i - 1] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+        }
+
+    public:
+        const char* format(uint64_t elapsedMs)
+        {
+            if (elapsedMs == _ms)
+                return _text;
+
+            const uint64_t secs = elapsedMs / 1000;
+            const uint64_t ms = elapsedMs - (secs * 1000);
+            _ms = elapsedMs;
+
+            if (secs == _secs)
+            {
+                writeDigits(_text + _length - 5, ms, 3);
+                return _text;
+            }
+            _secs = secs;
+
+            const uint64_t mins = secs / 60;
+            const uint64_t hrs = mins / 60;
+            if (hrs < 100)
+            {
+                char* dst = _text;
+                *dst++ = '[';
+                writeDigits(dst, hrs, 2);
+                dst += 2;
+                *dst++ = ':';
+                writeDigits(dst, mins % 60, 2);
+                dst += 2;
+                *dst++ = ':';
+                writeDigits(dst, secs % 60, 2);
+                dst += 2;
+                *dst++ = ':';
+                writeDigits(dst, ms, 3);
+                dst += 3;
+                *dst++ = ']';
+                *dst++ = ' ';
+                *dst = '\0';
+                _length = static_cast<size_t>(dst - _text);
+            }
+            else
+            {
+                const int len = snprintf(
+                    _text, sizeof(_text), "[%02llu:%02llu:%02llu:%03llu] ", static_cast<unsigned long long>(hrs),
+                    static_cast<unsigned long long>(mins % 60), static_cast<unsigned long long>(secs % 60),
+                    static_cast<unsigned long long>(ms));
+                _length = static_cast<size_t>(len);
+            }
+            return _text;
+        }
+
+        size_t length() const
+        {
+            return _length;
+        }
+    };
+
+} // namespace openhedz::diagnostics::logging
@@ -0,0 +1,239 @@
+﻿#include "trace.hpp"
+
+#include "logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(push)
+#    pragma warning(disable : 4996) // Secure CRT warnings, don't care.
+#endif
+
+namespace openhedz::diagnostics::trace
+{
+    // Deeper zones are still balanced but not recorded.
+    static constexpr uint32_t kMaxDepth = 64;
+
+    // The first zones of each thread are kept apart from the ring so startup survives a long session.
+    static constexpr uint32_t kPinnedEvents = 1024;
+
+    struct Event
+    {
+        const char* name;
+        int64_t start;
+        int64_t end;
+    };
+
+    struct ThreadBuffer
+    {
+        struct OpenZone
+        {
+            const char* name;
+            int64_t start;
+        };
+
+        uint32_t threadId = 0;
+        Event pinned[kPinnedEvents];
+        // Only written by the owning thread, read when the trace is written.
+        std::atomic<uint32_t> pinnedCount{ 0 };
+
+        std::unique_ptr<Event[]> events;
+        // Only written by the owning thread, read when the trace is written.
+        std::atomic<uint64_t> head{ 0 };
+
+        OpenZone open[kMaxDepth];
+        uint32_t depth = 0;
+    };
+
+    static std::atomic<bool> _enabled{ false };
+    static uint64_t _capacity = 0;
+    static int64_t _startTicks = 0;
+    static int64_t _frequency = 1;
+
+    // Buffers outlive their threads so zones of threads that already exited still get written.
+    static std::mutex _buffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+    static thread_local ThreadBuffer* _threadBuffer = nullptr;
+
+    static int64_t getTicks()
+    {
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart;
+    }
+
+    static ThreadBuffer* getThreadBuffer()
+    {
+        if (_threadBuffer == nullptr)
+        {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->threadId = GetCurrentThreadId();
+            buffer->events.reset(new Event[static_cast<size_t>(_capacity)]);
+
+            std::lock_guard<std::mutex> lock(_buffersMutex);
+            _threadBuffer = buffer.get();
+            _buffers.push_back(std::move(buffer));
+        }
+        return _threadBuffer;
+    }
+
+    void enable(uint32_t eventsPerThread)
+    {
+        if (_enabled.load())
+            return;
+
+        uint64_t size = 1;
+        while (size < eventsPerThread)
+        {
+            size <<= 1;
+        }
+        _capacity = size;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        _frequency = frequency.QuadPart;
+        _startTicks = getTicks();
+
+        _enabled.store(true);
+    }
+
+    bool isEnabled()
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    void begin(const char* name)
+    {
+        if (!_enabled.load(std::memory_order_acquire))
+            return;
+
+        auto* buffer = getThreadBuffer();
+        if (buffer->depth < kMaxDepth)
+        {
+            buffer->open[buffer->depth] = { name, getTicks() };
+        }
+        buffer->depth++;
+    }
+
+    void end()
+    {
+        if (!_enabled.load(std::memory_order_acquire))
+            return;
+
+        auto* buffer = getThreadBuffer();
+        if (buffer->depth == 0)
+            return;
+
+        buffer->depth--;
+        if (buffer->depth >= kMaxDepth)
+            return;
+
+        const auto& zone = buffer->open[buffer->depth];
+        const Event event{ zone.name, zone.start, getTicks() };
+
+        const uint32_t pinned = buffer->pinnedCount.load(std::memory_order_relaxed);
+        if (pinned < kPinnedEvents)
+        {
+            buffer->pinned[pinned] = event;
+            buffer->pinnedCount.store(pinned + 1, std::memory_order_release);
+            return;
+        }
+
+        const uint64_t pos = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[pos & (_capacity - 1)] = event;
+        buffer->head.store(pos + 1, std::memory_order_release);
+    }
+
+    // Copies the events of a thread that may still be recording. Whatever could have been overwritten
+    // during the copy is dropped afterwards, pinned events are never overwritten.
+    static void collectEvents(const ThreadBuffer& buffer, std::vector<Event>& events)
+    {
+        events.clear();
+
+        const uint32_t pinned = buffer.pinnedCount.load(std::memory_order_acquire);
+        events.insert(events.end(), buffer.pinned, buffer.pinned + pinned);
+        const size_t ringStart = events.size();
+
+        const uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = head > _capacity ? head - _capacity : 0;
+
+        for (uint64_t pos = first; pos < head; ++pos)
+        {
+            events.push_back(buffer.events[pos & (_capacity - 1)]);
+        }
+
+        const uint64_t newHead = buffer.head.load(std::memory_order_acquire);
+        if (newHead + 1 > first + _capacity)
+        {
+            const uint64_t overwritten = std::min<uint64_t>(newHead + 1 - _capacity - first, events.size() - ringStart);
+            const auto ringBegin = events.begin() + static_cast<ptrdiff_t>(ringStart);
+            events.erase(ringBegin, ringBegin + static_cast<ptrdiff_t>(overwritten));
+        }
+    }
+
+    static double toMicroseconds(int64_t ticks)
+    {
+        return static_cast<double>(ticks) * 1000000.0 / static_cast<double>(_frequency);
+    }
+
+    bool write(const char* fileName)
+    {
+        // Recording stops with the first write, zones that are still open are dropped.
+        if (!_enabled.exchange(false))
+            return false;
+
+        FILE* fp = fopen(fileName, "wt");
+        if (fp == nullptr)
+        {
+            logging::err(LOG_FMT("Unable to write trace to %s\n"), fileName);
+            return false;
+        }
+
+        const auto processId = GetCurrentProcessId();
+        fprintf(fp, "{\"traceEvents\":[\n");
+        fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"args\":{\"name\":\"OpenHEDZ\"}}", processId);
+
+        size_t count = 0;
+        std::vector<Event> events;
+
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        for (const auto& buffer : _buffers)
+        {
+            collectEvents(*buffer, events);
+
+            // Zones are recorded when they end, parents would come after their children.
+            std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+            for (const auto& event : events)
+            {
+                fprintf(
+                    fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.name,
+                    processId, buffer->threadId, toMicroseconds(event.start - _startTicks),
+                    toMicroseconds(event.end - event.start));
+            }
+            count += events.size();
+        }
+
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        fclose(fp);
+
+        logging::echo(LOG_FMT("Wrote %u trace events to %s\n"), static_cast<uint32_t>(count), fileName);
+        return true;
+    }
+
+} // namespace openhedz::diagnostics::trace
+
+#if defined(_MSC_VER)
+#    pragma warning(pop)
+#endif
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstdint>
+
+namespace openhedz::diagnostics::trace
+{
+    // The first zones of each thread are always kept, later ones go to a ring per thread of which only the
+    // most recent eventsPerThread zones end up in the trace. Calls after the first are ignored.
+    void enable(uint32_t eventsPerThread);
+
+    bool isEnabled();
+
+    // Only the pointer of name is stored, it has to stay valid until the trace is written. The zone is
+    // recorded when it ends, zones must be ended on the thread that began them and in reverse order.
+    void begin(const char* name);
+    void end();
+
+    // Writes the recorded zones in the Chrome trace event format, readable by chrome://tracing and Perfetto.
+    // Names are written as they are and must not contain quotes or backslashes. Recording stops afterwards.
+    bool write(const char* fileName);
+
+    class Zone
+    {
+        bool _active;
+
+    public:
+        explicit Zone(const char* name)
+            : _active(isEnabled())
+        {
+            if (_active)
+                begin(name);
+        }
+
+        ~Zone()
+        {
+            if (_active)
+                end();
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    };
+
+} // namespace openhedz::diagnostics::trace
@@ -0,0 +1,252 @@
+#include "hookprofile.hpp"
+
+#include "../diagnostics/logging.hpp"
+#include "hooks.hpp"
+#include "win_min.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <intrin.h>
+#include <vector>
+
+namespace openhedz::interop::hooks
+{
+    namespace logging = diagnostics::logging;
+
+    struct HookStats
+    {
+        const HookEntry* hook;
+        std::atomic<uint64_t> calls{ 0 };
+        std::atomic<uint64_t> totalCycles{ 0 };
+        std::atomic<uint64_t> maxCycles{ 0 };
+
+        explicit HookStats(const HookEntry* entry)
+            : hook(entry)
+        {
+        }
+    };
+
+    // One per call that has not returned yet, the return address of the caller is swapped for the
+    // leave stub and restored from here.
+    struct CallFrame
+    {
+        HookStats* stats;
+        uintptr_t returnAddress;
+        uintptr_t* returnSlot;
+        uint64_t start;
+    };
+
+    struct ShadowStack
+    {
+        static constexpr size_t kMaxDepth = 256;
+
+        CallFrame frames[kMaxDepth];
+        size_t depth;
+    };
+
+    // push imm32 (stats), jmp rel32 (profileEnter).
+    static constexpr size_t kThunkSize = 10;
+
+    static bool _profiling = false;
+    static std::mutex _mutex;
+    static std::deque<HookStats> _stats;
+
+    static uint64_t _startTsc = 0;
+    static LARGE_INTEGER _startCounter{};
+
+#if defined(_M_IX86)
+    static thread_local ShadowStack _shadowStack;
+
+    static void __cdecl profileLeaveStub();
+
+    // Called from profileEnter with the address of the return address of the caller, returns the target.
+    static void* __cdecl enterHook(HookStats* stats, uintptr_t* returnSlot)
+    {
+        stats->calls.fetch_add(1, std::memory_order_relaxed);
+
+        ShadowStack& shadow = _shadowStack;
+
+        // Frames at or below the current stack position belong to calls that were unwound without
+        // returning, by an exception or longjmp.
+        while (shadow.depth > 0 && shadow.frames[shadow.depth - 1].returnSlot <= returnSlot)
+        {
+            shadow.depth--;
+        }
+
+        // Too deep to track, the call is counted but not timed.
+        if (shadow.depth < ShadowStack::kMaxDepth)
+        {
+            CallFrame& frame = shadow.frames[shadow.depth++];
+            frame.stats = stats;
+            frame.returnAddress = *returnSlot;
+            frame.returnSlot = returnSlot;
+            *returnSlot = reinterpret_cast<uintptr_t>(&profileLeaveStub);
+            frame.start = __rdtsc();
+        }
+
+        return stats->hook->target;
+    }
+
+    // Called from profileLeaveStub when the target returns, returns where the caller wanted to return to.
+    static uintptr_t __cdecl leaveHook()
+    {
+        const uint64_t now = __rdtsc();
+
+        ShadowStack& shadow = _shadowStack;
+        const CallFrame& frame = shadow.frames[--shadow.depth];
+
+        const uint64_t cycles = now - frame.start;
+        frame.stats->totalCycles.fetch_add(cycles, std::memory_order_relaxed);
+
+        uint64_t maxCycles = frame.stats->maxCycles.load(std::memory_order_relaxed);
+        while (cycles > maxCycles
+               && !frame.stats->maxCycles.compare_exchange_weak(maxCycles, cycles, std::memory_order_relaxed))
+        {
+        }
+
+        return frame.returnAddress;
+    }
+
+    // Entered from a thunk with the stats pushed on top of the return address of the caller. All registers
+    // are preserved as the targets use various calling conventions.
+    static __declspec(naked) void profileEnter()
+    {
+        __asm
+        {
+            pushad
+            lea eax, [esp + 36]
+            push eax
+            push dword ptr [esp + 36]
+            call enterHook
+            add esp, 8
+            // Replace the stats with the target so the ret below jumps to it.
+            mov [esp + 32], eax
+            popad
+            ret
+        }
+    }
+
+    // The targets return here, eax and edx hold the return value and are preserved.
+    static __declspec(naked) void __cdecl profileLeaveStub()
+    {
+        __asm
+        {
+            push eax
+            pushad
+            call leaveHook
+            mov [esp + 32], eax
+            popad
+            ret
+        }
+    }
+#endif
+
+    bool enableProfiling()
+    {
+#if defined(_M_IX86)
+        QueryPerformanceCounter(&_startCounter);
+        _startTsc = __rdtsc();
+
+        _profiling = true;
+        return true;
+#else
+        logging::warn(logging::Category::Hooks, LOG_FMT("Hook profiling is only supported on x86\n"));
+        return false;
+#endif
+    }
+
+    bool isProfiling()
+    {
+        return _profiling;
+    }
+
+    std::vector<void*> createProfileThunks([[maybe_unused]] const std::vector<const HookEntry*>& hooks)
+    {
+        std::vector<void*> thunks;
+
+#if defined(_M_IX86)
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_profiling || hooks.empty())
+            return thunks;
+
+        const size_t poolSize = hooks.size() * kThunkSize;
+        auto* pool = static_cast<uint8_t*>(VirtualAlloc(nullptr, poolSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        if (pool == nullptr)
+        {
+            logging::err(logging::Category::Hooks, LOG_FMT("Unable to allocate the profiling thunks\n"));
+            return thunks;
+        }
+
+        thunks.reserve(hooks.size());
+        for (auto* hook : hooks)
+        {
+            HookStats* stats = &_stats.emplace_back(hook);
+
+            uint8_t* thunk = pool + thunks.size() * kThunkSize;
+            const auto statsAddress = reinterpret_cast<uint32_t>(stats);
+            const auto rel32 = static_cast<int32_t>(
+                reinterpret_cast<intptr_t>(&profileEnter) - reinterpret_cast<intptr_t>(thunk + kThunkSize));
+
+            thunk[0] = 0x68;
+            std::memcpy(thunk + 1, &statsAddress, sizeof(statsAddress));
+            thunk[5] = 0xE9;
+            std::memcpy(thunk + 6, &rel32, sizeof(rel32));
+
+            thunks.push_back(thunk);
+        }
+
+        DWORD oldProtect = 0;
+        VirtualProtect(pool, poolSize, PAGE_EXECUTE_READ, &oldProtect);
+        FlushInstructionCache(GetCurrentProcess(), pool, poolSize);
+#endif
+
+        return thunks;
+    }
+
+    void logProfile()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_profiling)
+            return;
+
+        // Calibrated against the performance counter over the whole session.
+        LARGE_INTEGER counter{};
+        LARGE_INTEGER frequency{};
+        QueryPerformanceCounter(&counter);
+        QueryPerformanceFrequency(&frequency);
+
+        const double seconds = static_cast<double>(counter.QuadPart - _startCounter.QuadPart)
+            / static_cast<double>(frequency.QuadPart);
+        const double cyclesPerUs = seconds > 0.0 ? static_cast<double>(__rdtsc() - _startTsc) / (seconds * 1e6) : 1.0;
+
+        std::vector<const HookStats*> sorted;
+        for (const auto& stats : _stats)
+        {
+            if (stats.calls.load(std::memory_order_relaxed) != 0)
+                sorted.push_back(&stats);
+        }
+
+        std::sort(sorted.begin(), sorted.end(), [](const HookStats* a, const HookStats* b) {
+            return a->totalCycles.load(std::memory_order_relaxed) > b->totalCycles.load(std::memory_order_relaxed);
+        });
+
+        logging::echo(
+            logging::Category::Hooks, LOG_FMT("Hook profile, %zu of %zu hooks called:\n"), sorted.size(), _stats.size());
+        for (const auto* stats : sorted)
+        {
+            const uint64_t calls = stats->calls.load(std::memory_order_relaxed);
+            const double totalUs = static_cast<double>(stats->totalCycles.load(std::memory_order_relaxed)) / cyclesPerUs;
+            const double maxUs = static_cast<double>(stats->maxCycles.load(std::memory_order_relaxed)) / cyclesPerUs;
+
+            logging::echo(
+                logging::Category::Hooks, LOG_FMT("  %-32s %10llu calls %12.1f us total %10.3f us avg %10.1f us max\n"),
+                stats->hook->name, calls, totalUs, totalUs / static_cast<double>(calls), maxUs);
+        }
+    }
+
+} // namespace openhedz::interop::hooks
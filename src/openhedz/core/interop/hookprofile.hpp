@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace openhedz::interop::hooks
+{
+    struct HookEntry;
+
+    // Profiled hooks jump to a generated thunk instead of the target, it counts the call and measures
+    // the cycles until the target returns. Only calls coming from the game pass through the thunk,
+    // calls between reimplemented functions are direct. Only supported on x86.
+    bool enableProfiling();
+
+    bool isProfiling();
+
+    // Returns the thunk each hook jump has to go to, empty when they could not be created.
+    std::vector<void*> createProfileThunks(const std::vector<const HookEntry*>& hooks);
+
+    // Logs calls, total, average and maximum time per hooked function, hottest first.
+    void logProfile();
+
+} // namespace openhedz::interop::hooks
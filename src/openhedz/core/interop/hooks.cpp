@@ -1,72 +1,440 @@
 #include "hooks.hpp"
 
 #include "../diagnostics/logging.hpp"
+#include "hookprofile.hpp"
 #include "win_min.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include <DbgHelp.h>
+
+#pragma comment(lib, "dbghelp.lib")
+
 namespace openhedz::interop::hooks
 {
     namespace logging = diagnostics::logging;
 
-    using HookRegistry = std::vector<const HookEntry*>;
+    static constexpr size_t kJmpSize = 5;
+
+#pragma section(".hooks$a", read)
+#pragma section(".hooks$z", read)
+
+    __declspec(allocate(".hooks$a")) static const HookEntry* const kHooksBegin = nullptr;
+    __declspec(allocate(".hooks$z")) static const HookEntry* const kHooksEnd = nullptr;
+
+    class Registry
+    {
+        std::vector<const HookEntry*> _hooks;
+        std::unordered_map<intptr_t, const HookEntry*> _bySource;
+        std::unordered_map<std::string_view, const HookEntry*> _byName;
+        std::vector<const HookEntry*> _byTarget;
+        // End of each target in _byTarget from the symbols, 0 while unknown.
+        std::vector<uintptr_t> _targetEnds;
+        std::atomic<bool> _hasTargetEnds{ false };
+        uintptr_t _targetsBegin = 0;
+        uintptr_t _targetsEnd = 0;
+
+    public:
+        Registry()
+        {
+            // The linker may pad between the contributions of different objects, padding is zero.
+            for (const HookEntry* const* it = &kHooksBegin + 1; it < &kHooksEnd; ++it)
+            {
+                if (*it != nullptr)
+                    _hooks.push_back(*it);
+            }
+
+            std::sort(
+                _hooks.begin(), _hooks.end(), [](const HookEntry* a, const HookEntry* b) { return a->source < b->source; });
+
+            // Rejects hooks whose jump would overwrite the jump of the previous hook, the others are still applied.
+            std::vector<const HookEntry*> accepted;
+            accepted.reserve(_hooks.size());
+            for (const HookEntry* hook : _hooks)
+            {
+                const HookEntry* previous = accepted.empty() ? nullptr : accepted.back();
+                if (previous != nullptr && previous->source + static_cast<intptr_t>(kJmpSize) > hook->source)
+                {
+                    logging::err(
+                        logging::Category::Hooks, LOG_FMT("Hook \"%s\" at %p overlaps hook \"%s\" at %p\n"), hook->name,
+                        (void*)hook->source, previous->name, (void*)previous->source);
+                    continue;
+                }
+                accepted.push_back(hook);
+            }
+            _hooks = std::move(accepted);
+
+            _bySource.reserve(_hooks.size());
+            _byName.reserve(_hooks.size());
+            for (const HookEntry* hook : _hooks)
+            {
+                _bySource.emplace(hook->source, hook);
+                _byName.emplace(hook->name, hook);
+            }
+
+            _byTarget = _hooks;
+            std::sort(_byTarget.begin(), _byTarget.end(), [](const HookEntry* a, const HookEntry* b) {
+                return reinterpret_cast<uintptr_t>(a->target) < reinterpret_cast<uintptr_t>(b->target);
+            });
+            _targetEnds.resize(_byTarget.size());
+
+            if (!_byTarget.empty())
+            {
+                HMODULE module = nullptr;
+                GetModuleHandleExA(
+                    GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                    reinterpret_cast<LPCSTR>(_byTarget.front()->target), &module);
+                if (module != nullptr)
+                {
+                    const auto base = reinterpret_cast<uintptr_t>(module);
+                    const auto* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+                    const auto* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+                    _targetsBegin = base;
+                    _targetsEnd = base + nt->OptionalHeader.SizeOfImage;
+                }
+            }
+        }
+
+        const std::vector<const HookEntry*>& getHooks() const
+        {
+            return _hooks;
+        }
+
+        const HookEntry* findBySource(intptr_t source) const
+        {
+            auto it = _bySource.find(source);
+            return it != _bySource.end() ? it->second : nullptr;
+        }
+
+        const HookEntry* findByName(std::string_view name) const
+        {
+            auto it = _byName.find(name);
+            return it != _byName.end() ? it->second : nullptr;
+        }
+
+        bool loadTargetSizes()
+        {
+            if (_hasTargetEnds.load(std::memory_order_acquire))
+                return true;
+
+            alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+            auto* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
 
-    HookRegistry& getRegistry()
+            size_t found = 0;
+            for (size_t i = 0; i < _byTarget.size(); i++)
+            {
+                const auto target = reinterpret_cast<uintptr_t>(_byTarget[i]->target);
+
+                memset(buffer, 0, sizeof(buffer));
+                symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+                symbol->MaxNameLen = MAX_SYM_NAME;
+
+                // A target without a symbol of its own, folded or inlined into another function, stays unknown.
+                DWORD64 displacement = 0;
+                if (SymFromAddr(GetCurrentProcess(), target, &displacement, symbol) == FALSE || displacement != 0
+                    || symbol->Size == 0)
+                    continue;
+
+                uintptr_t end = target + symbol->Size;
+                if (i + 1 < _byTarget.size())
+                {
+                    end = std::min(end, reinterpret_cast<uintptr_t>(_byTarget[i + 1]->target));
+                }
+                _targetEnds[i] = end;
+                found++;
+            }
+
+            if (found == 0)
+                return false;
+
+            logging::verbose(
+                logging::Category::Hooks, LOG_FMT("Found the size of %u of %u hook targets\n"), static_cast<uint32_t>(found),
+                static_cast<uint32_t>(_byTarget.size()));
+            _hasTargetEnds.store(true, std::memory_order_release);
+            return true;
+        }
+
+        const HookEntry* findByTarget(uintptr_t address) const
+        {
+            if (address < _targetsBegin || address >= _targetsEnd)
+                return nullptr;
+
+            auto it = std::upper_bound(_byTarget.begin(), _byTarget.end(), address, [](uintptr_t addr, const HookEntry* hook) {
+                return addr < reinterpret_cast<uintptr_t>(hook->target);
+            });
+            if (it == _byTarget.begin())
+                return nullptr;
+
+            const HookEntry* hook = *(it - 1);
+            if (address == reinterpret_cast<uintptr_t>(hook->target))
+                return hook;
+
+            // Anything past the start is only attributed when the symbols confirm it is inside the target.
+            if (!_hasTargetEnds.load(std::memory_order_acquire))
+                return nullptr;
+
+            const size_t index = static_cast<size_t>(it - 1 - _byTarget.begin());
+            return address < _targetEnds[index] ? hook : nullptr;
+        }
+    };
+
+    static Registry& getRegistry()
     {
-        static std::vector<const HookEntry*> reg;
-        return reg;
+        static Registry registry;
+        return registry;
     }
 
-    static bool applyHook(const HookEntry* hook)
+    struct PageRange
     {
-        intptr_t targetVA = reinterpret_cast<intptr_t>(hook->target);
+        uintptr_t begin;
+        uintptr_t end;
+        DWORD oldProtect;
+    };
+
+    // What is at the source while the hook is disabled and enabled.
+    struct HookState
+    {
+        uint8_t original[kJmpSize];
+        uint8_t patch[kJmpSize];
+        bool enabled;
+    };
+
+    static std::mutex _stateMutex;
+    static std::unordered_map<const HookEntry*, HookState> _states;
+
+    static void makeJump(intptr_t source, void* destination, uint8_t (&jmpRel32)[kJmpSize])
+    {
+        intptr_t targetVA = reinterpret_cast<intptr_t>(destination);
 
-        uint8_t jmpRel32[5]{};
         jmpRel32[0] = 0xE9;
 
-        int32_t rel32 = static_cast<int32_t>(targetVA - hook->source - 5);
+        int32_t rel32 = static_cast<int32_t>(targetVA - source - kJmpSize);
         std::memcpy(jmpRel32 + 1, &rel32, sizeof(rel32));
+    }
 
+    // Expects the page to be writable, saves the original bytes so the hook can be disabled later.
+    static void writeJump(const HookEntry* hook, void* destination)
+    {
         void* pSource = reinterpret_cast<void*>(hook->source);
 
-        SIZE_T bytesWritten = 0;
-        if (WriteProcessMemory(GetCurrentProcess(), pSource, jmpRel32, sizeof(jmpRel32), &bytesWritten) == FALSE)
+        HookState state{};
+        std::memcpy(state.original, pSource, kJmpSize);
+        makeJump(hook->source, destination, state.patch);
+        state.enabled = true;
+
+        std::memcpy(pSource, state.patch, kJmpSize);
+        _states[hook] = state;
+
+        logging::verbose(logging::Category::Hooks, LOG_FMT("Hook \"%s\" applied at %p\n"), hook->name, pSource);
+    }
+
+    // Replaces the bytes at the source while the game is running. Functions are aligned so the patch
+    // normally fits into one aligned qword and is swapped in a single locked write, a thread executing
+    // there sees either the old or the new instruction.
+    static bool patchCode(intptr_t source, const uint8_t (&bytes)[kJmpSize])
+    {
+        void* pSource = reinterpret_cast<void*>(source);
+
+        DWORD oldProtect = 0;
+        if (VirtualProtect(pSource, kJmpSize, PAGE_EXECUTE_READWRITE, &oldProtect) == FALSE)
         {
-            logging::err("Failed to write bytes at %p\n", pSource);
+            logging::err(logging::Category::Hooks, LOG_FMT("Failed to unprotect %p\n"), pSource);
             return false;
         }
 
-        logging::echo("Hook \"%s\" applied at %p\n", hook->name, pSource);
+        const auto address = static_cast<uintptr_t>(source);
+        const uintptr_t offset = address & 7;
+        if (offset + kJmpSize <= sizeof(LONG64))
+        {
+            auto* qword = reinterpret_cast<volatile LONG64*>(address - offset);
+
+            LONG64 current = *qword;
+            for (;;)
+            {
+                LONG64 desired = current;
+                std::memcpy(reinterpret_cast<uint8_t*>(&desired) + offset, bytes, kJmpSize);
+
+                const LONG64 previous = InterlockedCompareExchange64(qword, desired, current);
+                if (previous == current)
+                    break;
+                current = previous;
+            }
+        }
+        else
+        {
+            std::memcpy(pSource, bytes, kJmpSize);
+        }
 
+        VirtualProtect(pSource, kJmpSize, oldProtect, &oldProtect);
+        FlushInstructionCache(GetCurrentProcess(), pSource, kJmpSize);
         return true;
     }
 
-    static bool applyHooks()
+    // Sorted by address the pages touched by the jumps collapse into a few contiguous ranges.
+    static std::vector<PageRange> getPageRanges(const std::vector<const HookEntry*>& hooks)
     {
-        auto& registry = getRegistry();
-        for (auto* hook : registry)
+        SYSTEM_INFO sysInfo{};
+        GetSystemInfo(&sysInfo);
+
+        const uintptr_t pageSize = sysInfo.dwPageSize;
+        const uintptr_t pageMask = ~(pageSize - 1);
+
+        std::vector<PageRange> ranges;
+        for (auto* hook : hooks)
         {
-            if (!applyHook(hook))
+            const auto source = static_cast<uintptr_t>(hook->source);
+            const uintptr_t begin = source & pageMask;
+            const uintptr_t end = ((source + kJmpSize - 1) & pageMask) + pageSize;
+
+            if (!ranges.empty() && begin <= ranges.back().end)
             {
-                logging::err("Unable to hook %p\n", (void*)hook->source);
-                return false;
+                ranges.back().end = std::max(ranges.back().end, end);
+            }
+            else
+            {
+                ranges.push_back({ begin, end, 0 });
+            }
+        }
+        return ranges;
+    }
+
+    static bool applyHooks(bool profile)
+    {
+        const Registry& registry = getRegistry();
+        const std::vector<const HookEntry*>& hooks = registry.getHooks();
+        if (hooks.empty())
+            return true;
+
+        std::vector<PageRange> ranges = getPageRanges(hooks);
+
+        std::vector<void*> destinations;
+        if (profile)
+        {
+            destinations = createProfileThunks(hooks);
+        }
+        if (destinations.empty())
+        {
+            for (auto* hook : hooks)
+            {
+                destinations.push_back(hook->target);
+            }
+        }
+
+        // Unprotect everything first so either all hooks are written or none. The ranges lie within the
+        // code section of the executable, the protection of the first page holds for the whole range.
+        size_t unprotected = 0;
+        for (auto& range : ranges)
+        {
+            void* address = reinterpret_cast<void*>(range.begin);
+            if (VirtualProtect(address, range.end - range.begin, PAGE_EXECUTE_READWRITE, &range.oldProtect) == FALSE)
+            {
+                logging::err(logging::Category::Hooks, LOG_FMT("Failed to unprotect %p\n"), address);
+                break;
             }
+            unprotected++;
+        }
+
+        const bool result = unprotected == ranges.size();
+        if (result)
+        {
+            std::lock_guard<std::mutex> lock(_stateMutex);
+            _states.reserve(hooks.size());
+            for (size_t i = 0; i < hooks.size(); ++i)
+            {
+                writeJump(hooks[i], destinations[i]);
+            }
+        }
+
+        for (size_t i = 0; i < unprotected; ++i)
+        {
+            DWORD oldProtect = 0;
+            VirtualProtect(
+                reinterpret_cast<void*>(ranges[i].begin), ranges[i].end - ranges[i].begin, ranges[i].oldProtect,
+                &oldProtect);
         }
+
+        if (result)
+        {
+            const uintptr_t begin = ranges.front().begin;
+            FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<void*>(begin), ranges.back().end - begin);
+
+            logging::verbose(
+                logging::Category::Hooks, LOG_FMT("Applied %zu hooks in %zu page ranges\n"), hooks.size(), ranges.size());
+        }
+
+        return result;
+    }
+
+    bool init(bool profile)
+    {
+        if (profile && !enableProfiling())
+        {
+            profile = false;
+        }
+
+        if (!applyHooks(profile))
+            return false;
+
         return true;
     }
 
-    bool init()
+    bool setEnabled(const HookEntry& hook, bool enabled)
     {
-        if (!applyHooks())
+        std::lock_guard<std::mutex> lock(_stateMutex);
+
+        auto it = _states.find(&hook);
+        if (it == _states.end())
+            return false;
+
+        HookState& state = it->second;
+        if (state.enabled == enabled)
+            return true;
+
+        if (!patchCode(hook.source, enabled ? state.patch : state.original))
             return false;
 
+        state.enabled = enabled;
+
+        logging::echo(logging::Category::Hooks, LOG_FMT("Hook \"%s\" %s\n"), hook.name, enabled ? "enabled" : "disabled");
         return true;
     }
 
-    void add(const HookEntry& entry)
+    bool isEnabled(const HookEntry& hook)
+    {
+        std::lock_guard<std::mutex> lock(_stateMutex);
+
+        auto it = _states.find(&hook);
+        return it != _states.end() && it->second.enabled;
+    }
+
+    const std::vector<const HookEntry*>& getHooks()
+    {
+        return getRegistry().getHooks();
+    }
+
+    const HookEntry* findBySource(intptr_t source)
+    {
+        return getRegistry().findBySource(source);
+    }
+
+    const HookEntry* findByName(std::string_view name)
+    {
+        return getRegistry().findByName(name);
+    }
+
+    bool loadTargetSizes()
+    {
+        return getRegistry().loadTargetSizes();
+    }
+
+    const HookEntry* findByTarget(uintptr_t address)
     {
-        auto& reg = getRegistry();
-        reg.push_back(&entry);
+        return getRegistry().findByTarget(address);
     }
 
 } // namespace openhedz::interop::hooks
\ No newline at end of file
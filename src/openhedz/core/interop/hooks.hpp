@@ -1,30 +1,53 @@
 #pragma once
 
 #include <cstdint>
+#include <string_view>
+#include <vector>
 
 namespace openhedz::interop::hooks
 {
-    bool init();
-
-    void add(const struct HookEntry& entry);
+    // With profile set the hooks are instrumented, see hookprofile.hpp.
+    bool init(bool profile = false);
 
     struct HookEntry
     {
         intptr_t source;
         void* target;
         const char* name;
-
-        HookEntry(intptr_t src, void* dst, const char* n)
-            : source{ src }
-            , target{ dst }
-            , name{ n }
-        {
-            add(*this);
-        }
     };
 
+    // All hooks sorted by source address. Built once from the entries the linker collected, hooks
+    // that overlap another hook are reported and left out.
+    const std::vector<const HookEntry*>& getHooks();
+
+    const HookEntry* findBySource(intptr_t source);
+
+    const HookEntry* findByName(std::string_view name);
+
+    // Looks up where each hook target ends in the symbols, DbgHelp has to be initialized by the caller and
+    // no other thread may use it meanwhile. False when no target has a symbol, the first success is kept.
+    bool loadTargetSizes();
+
+    // The hook whose target contains address, for naming code in the profiler and the crash handler. Until
+    // loadTargetSizes succeeded only the first byte of a target is known to belong to it. Does not allocate
+    // after init.
+    const HookEntry* findByTarget(uintptr_t address);
+
+    // Puts the original bytes back or reapplies the jump, the game runs its own function while the
+    // hook is disabled. Fails for hooks that were not applied by init.
+    bool setEnabled(const HookEntry& hook, bool enabled);
+
+    bool isEnabled(const HookEntry& hook);
+
+    // Pointers to the entries are placed in .hooks$m, the linker merges the .hooks$ sections in
+    // alphabetical order so they end up between the markers in .hooks$a and .hooks$z. No code runs
+    // to register a hook.
+#pragma section(".hooks$m", read)
+
 #define HOOK_FUNCTION(src, dst)                                                                                                \
-    inline openhedz::interop::hooks::HookEntry s_HOOK_##src##_##dst(src, dst, #dst);                                           \
-    extern "C" __declspec(dllexport) openhedz::interop::hooks::HookEntry* HOOK_##src##_##dst = &s_HOOK_##src##_##dst;
+    inline const openhedz::interop::hooks::HookEntry s_HOOK_##src##_##dst{                                                     \
+        src, reinterpret_cast<void*>(&dst), #dst };                                                                            \
+    extern "C" __declspec(dllexport) __declspec(allocate(".hooks$m"))                                                          \
+        const openhedz::interop::hooks::HookEntry* const HOOK_##src##_##dst = &s_HOOK_##src##_##dst;
 
 } // namespace openhedz::interop::hooks
\ No newline at end of file
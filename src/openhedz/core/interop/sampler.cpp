@@ -0,0 +1,376 @@
+#include "sampler.hpp"
+
+#include "../diagnostics/logging.hpp"
+#include "hooks.hpp"
+#include "interop.hpp"
+#include "win_min.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <DbgHelp.h>
+
+#pragma comment(lib, "dbghelp.lib")
+
+namespace openhedz::interop::sampler
+{
+    namespace logging = diagnostics::logging;
+
+    static constexpr size_t kMaxDepth = 64;
+    // Upper bound for the part of the stack that is copied, only what is in use gets copied.
+    static constexpr uintptr_t kMaxStackSize = 1024 * 1024;
+    // How far back the start of an original function is searched for.
+    static constexpr uintptr_t kMaxFunctionSize = 64 * 1024;
+
+    struct ModuleRange
+    {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    // Copy of the used stack taken while the thread is suspended, the walk runs on it afterwards.
+    struct StackSnapshot
+    {
+        uintptr_t base = 0;
+        size_t size = 0;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    // StackWalk64 passes no context to the read callback, only the sampler thread walks.
+    static const StackSnapshot* _walkedStack = nullptr;
+
+    class Sampler
+    {
+        HANDLE _thread = nullptr;
+        uint32_t _intervalMs;
+        std::thread _worker;
+        std::atomic<bool> _stop{ false };
+
+        ModuleRange _exe{};
+        ModuleRange _self{};
+        bool _symbols = false;
+
+        StackSnapshot _stack;
+        std::unordered_map<uintptr_t, std::string> _names;
+        std::unordered_map<std::string, uint64_t> _stacks;
+        uint64_t _samples = 0;
+
+    public:
+        Sampler(HANDLE thread, uint32_t intervalMs)
+            : _thread(thread)
+            , _intervalMs(intervalMs)
+        {
+            _exe = getModuleRange(GetModuleHandleA(nullptr));
+
+            HMODULE self = nullptr;
+            GetModuleHandleExA(
+                GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                reinterpret_cast<LPCSTR>(&start), &self);
+            _self = getModuleRange(self);
+
+            _stack.data = std::make_unique<uint8_t[]>(kMaxStackSize);
+
+            SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+            _symbols = SymInitialize(GetCurrentProcess(), nullptr, TRUE) != FALSE;
+            if (_symbols)
+            {
+                // Lets the crash handler name hooks by more than the first byte of their target.
+                hooks::loadTargetSizes();
+            }
+
+            _worker = std::thread([this]() { run(); });
+        }
+
+        ~Sampler()
+        {
+            stopSampling();
+
+            if (_symbols)
+            {
+                SymCleanup(GetCurrentProcess());
+            }
+            CloseHandle(_thread);
+        }
+
+        void stopSampling()
+        {
+            _stop = true;
+            if (_worker.joinable())
+            {
+                _worker.join();
+            }
+        }
+
+        bool write(const char* fileName) const
+        {
+            FILE* fp = nullptr;
+            if (fopen_s(&fp, fileName, "wt") != 0 || fp == nullptr)
+                return false;
+
+            for (const auto& [stack, count] : _stacks)
+            {
+                fprintf(fp, "%s %llu\n", stack.c_str(), static_cast<unsigned long long>(count));
+            }
+            fclose(fp);
+
+            logging::echo(LOG_FMT("Wrote %llu samples to %s\n"), _samples, fileName);
+            return true;
+        }
+
+    private:
+        static ModuleRange getModuleRange(HMODULE module)
+        {
+            if (module == nullptr)
+                return {};
+
+            const auto base = reinterpret_cast<uintptr_t>(module);
+            const auto* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+            const auto* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+            return { base, base + nt->OptionalHeader.SizeOfImage };
+        }
+
+        static bool contains(const ModuleRange& range, uintptr_t addr)
+        {
+            return addr >= range.begin && addr < range.end;
+        }
+
+        // Serves reads of the copied stack from the snapshot, code and everything else is read live.
+        static BOOL CALLBACK readMemory(HANDLE process, DWORD64 address, PVOID buffer, DWORD size, LPDWORD bytesRead)
+        {
+            const StackSnapshot* stack = _walkedStack;
+            if (stack != nullptr && address >= stack->base && address + size <= stack->base + stack->size)
+            {
+                std::memcpy(buffer, stack->data.get() + (address - stack->base), size);
+                *bytesRead = size;
+                return TRUE;
+            }
+
+            SIZE_T read = 0;
+            const BOOL result = ReadProcessMemory(
+                process, reinterpret_cast<const void*>(static_cast<uintptr_t>(address)), buffer, size, &read);
+            *bytesRead = static_cast<DWORD>(read);
+            return result;
+        }
+
+        // Nothing may allocate or take a lock while the thread is suspended, it might hold the heap lock.
+        // Only the registers and the used part of the stack are copied, the walk happens after resuming.
+        bool capture(CONTEXT& context)
+        {
+            if (SuspendThread(_thread) == static_cast<DWORD>(-1))
+                return false;
+
+            context = {};
+            context.ContextFlags = CONTEXT_FULL;
+            const bool result = GetThreadContext(_thread, &context) != FALSE;
+
+            _stack.size = 0;
+            MEMORY_BASIC_INFORMATION info{};
+            if (result && VirtualQuery(reinterpret_cast<const void*>(context.Esp), &info, sizeof(info)) != 0)
+            {
+                // The committed part of a stack is a single region ending at the stack base.
+                const uintptr_t regionEnd = reinterpret_cast<uintptr_t>(info.BaseAddress) + info.RegionSize;
+                _stack.base = context.Esp;
+                _stack.size = static_cast<size_t>(std::min<uintptr_t>(regionEnd - context.Esp, kMaxStackSize));
+                std::memcpy(_stack.data.get(), reinterpret_cast<const void*>(_stack.base), _stack.size);
+            }
+
+            ResumeThread(_thread);
+            return result;
+        }
+
+        // Release builds omit frame pointers, StackWalk64 uses the frame data of the symbols to unwind
+        // those frames and falls back to the frame pointer chain where it has none.
+        size_t walk(CONTEXT& context, uintptr_t (&frames)[kMaxDepth])
+        {
+            size_t depth = 0;
+            frames[depth++] = context.Eip;
+            if (!_symbols)
+                return depth;
+
+            STACKFRAME64 frame{};
+            frame.AddrPC.Offset = context.Eip;
+            frame.AddrPC.Mode = AddrModeFlat;
+            frame.AddrFrame.Offset = context.Ebp;
+            frame.AddrFrame.Mode = AddrModeFlat;
+            frame.AddrStack.Offset = context.Esp;
+            frame.AddrStack.Mode = AddrModeFlat;
+
+            _walkedStack = &_stack;
+
+            // The first step yields the frame of the current instruction, it is already in frames.
+            bool first = true;
+            while (depth < kMaxDepth
+                   && StackWalk64(
+                       IMAGE_FILE_MACHINE_I386, GetCurrentProcess(), _thread, &frame, &context, readMemory,
+                       SymFunctionTableAccess64, SymGetModuleBase64, nullptr)
+                       != FALSE)
+            {
+                if (frame.AddrPC.Offset == 0)
+                    break;
+                if (!first)
+                    frames[depth++] = static_cast<uintptr_t>(frame.AddrPC.Offset);
+                first = false;
+            }
+
+            _walkedStack = nullptr;
+            return depth;
+        }
+
+        // Original functions are aligned to 16 bytes and padded with nop or int3.
+        uintptr_t findExeFunction(uintptr_t addr) const
+        {
+            const uintptr_t limit = addr - _exe.begin > kMaxFunctionSize ? addr - kMaxFunctionSize : _exe.begin;
+            for (uintptr_t start = addr & ~uintptr_t(15); start > limit; start -= 16)
+            {
+                const auto prev = *reinterpret_cast<const uint8_t*>(start - 1);
+                if (prev == 0x90 || prev == 0xCC)
+                    return start;
+            }
+            return addr;
+        }
+
+        std::string resolve(uintptr_t addr)
+        {
+            char name[256];
+
+            if (contains(_exe, addr))
+            {
+                const uintptr_t function = findExeFunction(addr);
+
+                // The original of a hooked function only runs while its hook is disabled.
+                if (const auto* hook = hooks::findBySource(static_cast<intptr_t>(function)))
+                {
+                    sprintf_s(name, "Hedz.exe!%s", hook->name);
+                    return name;
+                }
+
+                sprintf_s(name, "Hedz.exe!sub_%X", static_cast<unsigned>(function));
+                return name;
+            }
+
+            if (_symbols)
+            {
+                alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+                auto* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+                symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+                symbol->MaxNameLen = MAX_SYM_NAME;
+
+                DWORD64 displacement = 0;
+                if (SymFromAddr(GetCurrentProcess(), addr, &displacement, symbol) != FALSE)
+                {
+                    const auto* hook = hooks::findByTarget(static_cast<uintptr_t>(symbol->Address));
+                    if (hook != nullptr && reinterpret_cast<uintptr_t>(hook->target) == symbol->Address)
+                    {
+                        sprintf_s(name, "hook!%s", hook->name);
+                        return name;
+                    }
+                    if (contains(_self, addr))
+                    {
+                        sprintf_s(name, "openhedz!%s", symbol->Name);
+                        return name;
+                    }
+                    return symbol->Name;
+                }
+            }
+
+            // Frames without a symbol are only folded into a hook when they are known to be inside its target.
+            if (const auto* hook = hooks::findByTarget(addr))
+            {
+                sprintf_s(name, "hook!%s", hook->name);
+                return name;
+            }
+
+            if (contains(_self, addr))
+            {
+                sprintf_s(name, "openhedz.dll+0x%X", static_cast<unsigned>(addr - _self.begin));
+                return name;
+            }
+
+            sprintf_s(name, "0x%08X", static_cast<unsigned>(addr));
+            return name;
+        }
+
+        const std::string& getName(uintptr_t addr)
+        {
+            auto it = _names.find(addr);
+            if (it == _names.end())
+            {
+                it = _names.emplace(addr, resolve(addr)).first;
+            }
+            return it->second;
+        }
+
+        void run()
+        {
+            uintptr_t frames[kMaxDepth];
+            std::string stack;
+            CONTEXT context;
+
+            while (!_stop.load())
+            {
+                Sleep(_intervalMs);
+
+                if (!capture(context))
+                    continue;
+
+                const size_t depth = walk(context, frames);
+
+                stack.clear();
+                for (size_t i = depth; i > 0; --i)
+                {
+                    if (i != depth)
+                        stack += ';';
+                    stack += getName(frames[i - 1]);
+                }
+
+                _stacks[stack]++;
+                _samples++;
+            }
+        }
+    };
+
+    // Not destroyed at exit, joining the worker while the process is shutting down could hang.
+    static Sampler* _sampler = nullptr;
+
+    bool start(uint32_t threadId, uint32_t intervalMs)
+    {
+        if (_sampler != nullptr)
+            return false;
+
+        HANDLE thread = OpenThread(
+            THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, static_cast<DWORD>(threadId));
+        if (thread == nullptr)
+        {
+            logging::err(LOG_FMT("Unable to open thread %u for sampling\n"), threadId);
+            return false;
+        }
+
+        _sampler = new Sampler(thread, intervalMs);
+        return true;
+    }
+
+    bool isRunning()
+    {
+        return _sampler != nullptr;
+    }
+
+    void stop(const char* fileName)
+    {
+        if (_sampler == nullptr)
+            return;
+
+        std::unique_ptr<Sampler> sampler(_sampler);
+        _sampler = nullptr;
+
+        sampler->stopSampling();
+        sampler->write(fileName);
+    }
+
+} // namespace openhedz::interop::sampler
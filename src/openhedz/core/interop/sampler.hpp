@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace openhedz::interop::sampler
+{
+    // Samples the call stack of the thread every intervalMs from a background thread. Frames are named
+    // after the hook they belong to, the OpenHEDZ symbol or the original function in the executable.
+    bool start(uint32_t threadId, uint32_t intervalMs);
+
+    bool isRunning();
+
+    // Stops sampling and writes the collected stacks in the folded format used by flamegraph.pl and
+    // speedscope, one "root;...;leaf count" line per distinct stack.
+    void stop(const char* fileName);
+
+} // namespace openhedz::interop::sampler
@@ -1,16 +1,24 @@
 #include "game.hpp"
 
 #include "core/diagnostics/logging.hpp"
+#include "core/diagnostics/logrecorder.hpp"
+#include "core/diagnostics/trace.hpp"
+#include "core/interop/hookprofile.hpp"
 #include "core/interop/interop.hpp"
+#include "core/interop/sampler.hpp"
 #include "functions.hpp"
 #include "globals.hpp"
+#include "utils/textcache.hpp"
 
 #include <array>
+#include <string>
+#include <vector>
 #include <varargs.h>
 
 namespace openhedz
 {
     namespace logging = diagnostics::logging;
+    namespace trace = diagnostics::trace;
 
     // 00413D80
     int logMessage(const char* fmt, ...)
@@ -25,11 +33,11 @@ namespace openhedz
             auto tempBuf = std::make_unique<char[]>(res + 1);
             res = vsnprintf_s(tempBuf.get(), res + 1, res, fmt, arglist);
 
-            logging::warn("%s", tempBuf.get());
+            logging::warn(LOG_FMT("%s"), tempBuf.get());
         }
         else
         {
-            logging::warn("%s", buffer);
+            logging::warn(LOG_FMT("%s"), buffer);
         }
         return res;
     }
@@ -60,7 +68,7 @@ namespace openhedz
         {
             if (!IsDebuggerPresent())
             {
-                logging::echo("Waiting for debugger\n");
+                logging::echo(LOG_FMT("Waiting for debugger\n"));
 
                 while (!IsDebuggerPresent())
                 {
@@ -71,6 +79,112 @@ namespace openhedz
         }
     }
 
+    static void setupTextCache()
+    {
+        constexpr size_t kTextCacheSize = 4 * 1024 * 1024;
+
+        auto* cmdLine = GetCommandLineA();
+        if (strstr(cmdLine, "-textcache") != nullptr)
+        {
+            textcache::setCapacity(kTextCacheSize);
+        }
+    }
+
+    static void logTextCacheStats()
+    {
+        const textcache::Stats stats = textcache::getStats();
+
+        logging::echo(
+            logging::Category::Text,
+            LOG_FMT("Text cache: %llu hits, %llu misses, %llu evictions, %zu entries, %zu bytes\n"), stats.hits,
+            stats.misses, stats.evictions, stats.entries, stats.sizeInBytes);
+    }
+
+    static void setupSampler()
+    {
+        constexpr uint32_t kSampleIntervalMs = 1;
+
+        auto* cmdLine = GetCommandLineA();
+        if (strstr(cmdLine, "-sampleprofile") != nullptr)
+        {
+            interop::sampler::start(GetCurrentThreadId(), kSampleIntervalMs);
+        }
+    }
+
+    static void setupTrace()
+    {
+        constexpr uint32_t kEventsPerThread = 64 * 1024;
+
+        auto* cmdLine = GetCommandLineA();
+        if (strstr(cmdLine, "-trace") != nullptr)
+        {
+            trace::enable(kEventsPerThread);
+        }
+    }
+
+    // Writes the trace however entrypoint is left, a startup that fails is as interesting as one that succeeds.
+    struct TraceWriter
+    {
+        ~TraceWriter()
+        {
+            if (trace::isEnabled())
+            {
+                trace::write("openhedz.trace.json");
+            }
+        }
+    };
+
+    // F8 writes what the flight recorder holds without waiting for a crash.
+    static void dumpRecorder()
+    {
+        constexpr const char kFileName[] = "openhedz.recorder.log";
+
+        auto* recorder = logging::get().getRecorder();
+        if (recorder == nullptr)
+            return;
+
+        if (recorder->dump(kFileName))
+        {
+            logging::echo(LOG_FMT("Flight recorder written to %s\n"), kFileName);
+        }
+        else
+        {
+            logging::err(LOG_FMT("Unable to write the flight recorder to %s\n"), kFileName);
+        }
+    }
+
+    static std::vector<const interop::hooks::HookEntry*> _toggleHooks;
+
+    // Collects the hooks given with -abhook:<name>, F9 switches them between the original function and the
+    // reimplementation.
+    static void setupHookToggles()
+    {
+        constexpr const char kOption[] = "-abhook:";
+
+        auto* cmdLine = GetCommandLineA();
+        for (const char* opt = strstr(cmdLine, kOption); opt != nullptr; opt = strstr(opt, kOption))
+        {
+            opt += sizeof(kOption) - 1;
+
+            const std::string name(opt, strcspn(opt, " \t\""));
+            const auto* hook = interop::hooks::findByName(name);
+            if (hook == nullptr)
+            {
+                logging::warn(logging::Category::Hooks, LOG_FMT("Unknown hook %s\n"), name.c_str());
+                continue;
+            }
+            _toggleHooks.push_back(hook);
+        }
+    }
+
+    static void toggleHooks()
+    {
+        for (const auto* hook : _toggleHooks)
+        {
+            interop::hooks::setEnabled(*hook, !interop::hooks::isEnabled(*hook));
+        }
+    }
+
     // 0x0045E9C0
     void initRand()
     {
@@ -96,7 +210,14 @@ namespace openhedz
     {
         waitForDebugger();
 
-        logging::echo("OpenHEDZ Startup\n");
+        setupTrace();
+        TraceWriter traceWriter;
+
+        logging::echo(LOG_FMT("OpenHEDZ Startup\n"));
+
+        setupTextCache();
+        setupHookToggles();
+        setupSampler();
 
         std::memset(dword_5E5140.get(), 0, 0x2560u);
 
@@ -116,7 +237,10 @@ namespace openhedz
 
         initRand();
         initSinTable();
-        initAssetPaths();
+        {
+            trace::Zone zone("initAssetPaths");
+            initAssetPaths();
+        }
 
         // Events
         {
@@ -153,23 +277,32 @@ namespace openhedz
             int newFonts = AddFontResourceA(fontsPath);
             if (newFonts == 0)
             {
-                logging::warn("Unable to load font resources\n");
+                logging::warn(LOG_FMT("Unable to load font resources\n"));
             }
         }
 
         ref_598D58 = 1;
         gUseFullscreen = 1;
 
-        if (!initWindow(hInstance))
-            return EXIT_FAILURE;
+        {
+            trace::Zone zone("initWindow");
+            if (!initWindow(hInstance))
+                return EXIT_FAILURE;
+        }
 
-        if (!setupInputDevices(gWnd, hInstance))
-            return EXIT_FAILURE;
+        {
+            trace::Zone zone("setupInputDevices");
+            if (!setupInputDevices(gWnd, hInstance))
+                return EXIT_FAILURE;
+        }
 
         setupKeyMapping();
         setupMapFilePath();
         sub_43FBC0();
-        loadTextureData();
+        {
+            trace::Zone zone("loadTextureData");
+            loadTextureData();
+        }
 
         // Config window
         for (;;)
@@ -196,10 +329,14 @@ namespace openhedz
 
         setupWindowHook();
 
-        if (!startGame())
-            return EXIT_SUCCESS;
+        {
+            trace::Zone zone("startGame");
+            if (!startGame())
+                return EXIT_SUCCESS;
+        }
 
         {
+            trace::Zone loopZone("messageLoop");
             MSG msg{};
 
             auto accelerators = LoadAcceleratorsA(hInstance, "AppAccel");
@@ -207,6 +344,19 @@ namespace openhedz
             {
                 if (PeekMessageA(&msg, 0, 0, 0, 1u))
                 {
+                    if (msg.message == WM_KEYDOWN && msg.wParam == VK_F11 && interop::hooks::isProfiling())
+                    {
+                        interop::hooks::logProfile();
+                    }
+                    else if (msg.message == WM_KEYDOWN && msg.wParam == VK_F9)
+                    {
+                        toggleHooks();
+                    }
+                    else if (msg.message == WM_KEYDOWN && msg.wParam == VK_F8)
+                    {
+                        dumpRecorder();
+                    }
+
                     if (!gWnd || !TranslateAcceleratorA(gWnd, accelerators, &msg))
                     {
                         TranslateMessage(&msg);
@@ -220,6 +370,21 @@ namespace openhedz
             }
         }
 
+        if (textcache::isEnabled())
+        {
+            logTextCacheStats();
+        }
+
+        if (interop::hooks::isProfiling())
+        {
+            interop::hooks::logProfile();
+        }
+
+        if (interop::sampler::isRunning())
+        {
+            interop::sampler::stop("openhedz.folded");
+        }
+
         DestroyWindow(gWnd);
         CloseHandle(gOneTimeSemaphore);
 
@@ -28,7 +28,7 @@ namespace openhedz
     inline interop::Var<0x005DF310, char[256]> gPathRoot;
     inline interop::Var<0x005D61E0, char[256]> gPathRootAlt;
 
-    inline interop::Var<0x005DC800, uint16_t[254]> gRandValueTable;
+    inline interop::Var<0x005DC800, uint16_t[255]> gRandValueTable;
     inline interop::Var<0x005D8800, float[4096]> gSinTable;
 
     inline interop::Var<0x00598D58, uint32_t> ref_598D58;
@@ -0,0 +1,227 @@
+#include "textcache.hpp"
+
+#include "textdecoder.hpp"
+#include "workerpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace openhedz::textcache
+{
+    struct CacheEntry
+    {
+        uint64_t hash;
+        // Copy of the compressed blob, used to verify a hit since the blob size is not stored in it.
+        std::vector<uint8_t> compressed;
+        DecodedText text;
+    };
+
+    using CacheList = std::list<CacheEntry>;
+
+    static std::mutex _mutex;
+    static std::atomic<size_t> _capacity{ 0 };
+    static CacheList _entries;
+    static std::unordered_multimap<uint64_t, CacheList::iterator> _index;
+    static size_t _sizeInBytes = 0;
+    static Stats _stats{};
+
+    static size_t getEntrySize(const CacheEntry& entry)
+    {
+        return entry.compressed.size() + entry.text->size();
+    }
+
+    // Upper bound of the payload bytes that go into the hash, blobs sharing a code table are told apart by them.
+    static constexpr uint32_t kPayloadSampleSize = 32;
+
+    static void hashBytes(uint64_t& hash, const uint8_t* data, uint32_t size)
+    {
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 0x100000001B3ull;
+        }
+    }
+
+    // The payload size is only known after decoding. With a complete code table every symbol takes at least
+    // the shortest code length, so a well formed blob has at least that many bits of payload.
+    static uint32_t getPayloadSampleSize(const uint8_t* table, uint32_t numEntries, uint32_t uncompressedSize)
+    {
+        uint64_t kraftSum = 0;
+        uint32_t minLength = 32;
+        for (uint32_t i = 0; i < numEntries; ++i)
+        {
+            const uint32_t length = table[i * 6 + 5];
+            if (length == 0 || length > 32)
+                return 0;
+
+            kraftSum += 1ull << (32 - length);
+            minLength = std::min(minLength, length);
+        }
+        if (kraftSum != 1ull << 32)
+            return 0;
+
+        const uint64_t payloadSize = uint64_t{ uncompressedSize } * minLength / 8;
+        return static_cast<uint32_t>(std::min<uint64_t>(payloadSize, kPayloadSampleSize));
+    }
+
+    // FNV-1a over the header, the code table and the start of the payload.
+    static uint64_t hashBlob(const uint8_t* buf)
+    {
+        const uint32_t numEntries = *(uint16_t*)buf;
+        const uint32_t uncompressedSize = *(uint32_t*)(buf + 2);
+        const uint32_t headerSize = 6 + numEntries * 6;
+
+        uint64_t hash = 0xCBF29CE484222325ull;
+        hashBytes(hash, buf, headerSize);
+        hashBytes(hash, buf + headerSize, getPayloadSampleSize(buf + 6, numEntries, uncompressedSize));
+        return hash;
+    }
+
+    // Compares byte by byte and stops at the first difference, a blob can only be identical
+    // up to the size of the cached one if it is the same size so this never reads past it.
+    static bool isSameBlob(const CacheEntry& entry, const uint8_t* buf)
+    {
+        for (size_t i = 0; i < entry.compressed.size(); ++i)
+        {
+            if (entry.compressed[i] != buf[i])
+                return false;
+        }
+        return true;
+    }
+
+    static CacheList::iterator findEntry(uint64_t hash, const uint8_t* buf)
+    {
+        auto range = _index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (isSameBlob(*it->second, buf))
+                return it->second;
+        }
+        return _entries.end();
+    }
+
+    static void removeEntry(CacheList::iterator entryIt)
+    {
+        auto range = _index.equal_range(entryIt->hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == entryIt)
+            {
+                _index.erase(it);
+                break;
+            }
+        }
+        _sizeInBytes -= getEntrySize(*entryIt);
+        _entries.erase(entryIt);
+    }
+
+    static void evict(size_t maxBytes)
+    {
+        while (_sizeInBytes > maxBytes && !_entries.empty())
+        {
+            removeEntry(std::prev(_entries.end()));
+            _stats.evictions++;
+        }
+    }
+
+    void setCapacity(size_t maxBytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _capacity = maxBytes;
+        evict(maxBytes);
+    }
+
+    bool isEnabled()
+    {
+        return _capacity.load(std::memory_order_relaxed) != 0;
+    }
+
+    DecodedText decompress(const uint8_t* buf)
+    {
+        const bool enabled = isEnabled();
+        const uint64_t hash = enabled ? hashBlob(buf) : 0;
+
+        if (enabled)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto it = findEntry(hash, buf);
+            if (it != _entries.end())
+            {
+                _entries.splice(_entries.begin(), _entries, it);
+                _stats.hits++;
+                return it->text;
+            }
+            _stats.misses++;
+        }
+
+        // Decode without holding the lock, other threads may look up or decode other blobs meanwhile.
+        TextDecoder decoder;
+        decoder.begin(buf);
+
+        auto data = std::make_shared<std::vector<uint8_t>>(decoder.getUncompressedSize());
+        decoder.decodeInto(data->data(), data->size());
+
+        DecodedText text = std::move(data);
+        if (!enabled)
+            return text;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Another thread may have decoded the same blob in the meantime.
+        auto it = findEntry(hash, buf);
+        if (it != _entries.end())
+            return it->text;
+
+        CacheEntry entry{};
+        entry.hash = hash;
+        entry.compressed.assign(buf, buf + decoder.getInputSize());
+        entry.text = text;
+
+        const size_t entrySize = getEntrySize(entry);
+        const size_t capacity = _capacity;
+        if (entrySize > capacity)
+            return text;
+
+        evict(capacity - entrySize);
+
+        _entries.push_front(std::move(entry));
+        _index.emplace(hash, _entries.begin());
+        _sizeInBytes += entrySize;
+
+        return text;
+    }
+
+    // Started by the first batch and kept, never destroyed as joining threads while the process exits can hang.
+    static WorkerPool& getPool()
+    {
+        static WorkerPool* pool = new WorkerPool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return *pool;
+    }
+
+    std::vector<DecodedText> decompressBatch(const std::vector<const uint8_t*>& blobs)
+    {
+        std::vector<DecodedText> res(blobs.size());
+
+        // Blobs vary a lot in size, the pool hands them out one at a time.
+        getPool().run(blobs.size(), [&](size_t i) { res[i] = decompress(blobs[i]); });
+
+        return res;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        Stats res = _stats;
+        res.entries = _entries.size();
+        res.sizeInBytes = _sizeInBytes;
+        return res;
+    }
+
+} // namespace openhedz::textcache
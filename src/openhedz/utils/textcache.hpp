@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace openhedz::textcache
+{
+    using DecodedText = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t sizeInBytes;
+    };
+
+    // Sets the maximum number of bytes held by the cache, 0 disables caching which is the default.
+    void setCapacity(size_t maxBytes);
+
+    bool isEnabled();
+
+    // Returns the decoded contents of the compressed text blob, repeated calls with the same blob
+    // share the same buffer while it stays in the cache.
+    DecodedText decompress(const uint8_t* buf);
+
+    // Decompresses all blobs on a pool of worker threads and returns the results in the same order,
+    // with caching enabled this also prepares the cache for later decompressText calls. The pool is
+    // started by the first call and reused by later ones.
+    std::vector<DecodedText> decompressBatch(const std::vector<const uint8_t*>& blobs);
+
+    Stats getStats();
+
+} // namespace openhedz::textcache
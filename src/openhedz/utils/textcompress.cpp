@@ -0,0 +1,197 @@
+#include "textcompress.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <queue>
+
+namespace openhedz
+{
+    struct EncodeNode
+    {
+        uint64_t weight;
+        int32_t left;
+        int32_t right;
+        int32_t symbol;
+    };
+
+    struct EncodeCode
+    {
+        uint32_t code;
+        uint8_t length;
+    };
+
+    using SymbolCounts = std::array<uint64_t, 256>;
+    using SymbolCodes = std::array<EncodeCode, 256>;
+
+    static void computeCodeLengths(const SymbolCounts& counts, SymbolCodes& codes)
+    {
+        std::vector<EncodeNode> nodes;
+        nodes.reserve(512);
+
+        // Ties are broken by node index so the output does not depend on the queue implementation.
+        using QueueItem = std::pair<uint64_t, int32_t>;
+        std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+        for (int32_t symbol = 0; symbol < 256; ++symbol)
+        {
+            if (counts[symbol] == 0)
+                continue;
+
+            nodes.push_back({ counts[symbol], -1, -1, symbol });
+            queue.push({ counts[symbol], static_cast<int32_t>(nodes.size() - 1) });
+        }
+
+        if (nodes.empty())
+            return;
+
+        // A single symbol still needs one bit, a code of length 0 would make the root a leaf.
+        if (nodes.size() == 1)
+        {
+            codes[nodes[0].symbol].length = 1;
+            return;
+        }
+
+        while (queue.size() > 1)
+        {
+            const QueueItem a = queue.top();
+            queue.pop();
+            const QueueItem b = queue.top();
+            queue.pop();
+
+            nodes.push_back({ a.first + b.first, a.second, b.second, -1 });
+            queue.push({ a.first + b.first, static_cast<int32_t>(nodes.size() - 1) });
+        }
+
+        std::vector<std::pair<int32_t, uint32_t>> stack;
+        stack.push_back({ queue.top().second, 0 });
+        while (!stack.empty())
+        {
+            const auto [index, depth] = stack.back();
+            stack.pop_back();
+
+            const EncodeNode& node = nodes[index];
+            if (node.symbol >= 0)
+            {
+                // Clamped here, limitCodeLengths restores a valid prefix code afterwards.
+                codes[node.symbol].length = static_cast<uint8_t>(std::min(depth, kMaxCodeLength));
+                continue;
+            }
+            stack.push_back({ node.left, depth + 1 });
+            stack.push_back({ node.right, depth + 1 });
+        }
+    }
+
+    // Lengthens the codes of the least frequent symbols until the Kraft sum fits again after
+    // codes longer than kMaxCodeLength were clamped.
+    static void limitCodeLengths(const SymbolCounts& counts, SymbolCodes& codes)
+    {
+        uint64_t kraft = 0;
+        for (const EncodeCode& code : codes)
+        {
+            if (code.length != 0)
+                kraft += 1ull << (kMaxCodeLength - code.length);
+        }
+
+        const uint64_t kraftLimit = 1ull << kMaxCodeLength;
+        if (kraft <= kraftLimit)
+            return;
+
+        std::vector<int32_t> symbols;
+        for (int32_t symbol = 0; symbol < 256; ++symbol)
+        {
+            if (codes[symbol].length != 0)
+                symbols.push_back(symbol);
+        }
+        std::stable_sort(symbols.begin(), symbols.end(), [&](int32_t a, int32_t b) { return counts[a] < counts[b]; });
+
+        while (kraft > kraftLimit)
+        {
+            for (const int32_t symbol : symbols)
+            {
+                EncodeCode& code = codes[symbol];
+                if (code.length >= kMaxCodeLength)
+                    continue;
+
+                kraft -= 1ull << (kMaxCodeLength - code.length - 1);
+                code.length++;
+                break;
+            }
+        }
+    }
+
+    // Assigns canonical codes ordered by length and symbol.
+    static void assignCodes(SymbolCodes& codes)
+    {
+        uint64_t next = 0;
+        for (uint32_t length = 1; length <= kMaxCodeLength; ++length)
+        {
+            for (EncodeCode& code : codes)
+            {
+                if (code.length == length)
+                    code.code = static_cast<uint32_t>(next++);
+            }
+            next <<= 1;
+        }
+    }
+
+    std::vector<uint8_t> compressText(const uint8_t* data, size_t size)
+    {
+        SymbolCounts counts{};
+        for (size_t i = 0; i < size; ++i)
+        {
+            counts[data[i]]++;
+        }
+
+        SymbolCodes codes{};
+        computeCodeLengths(counts, codes);
+        limitCodeLengths(counts, codes);
+        assignCodes(codes);
+
+        std::vector<uint8_t> res(6);
+
+        uint16_t numEntries = 0;
+        for (uint32_t symbol = 0; symbol < 256; ++symbol)
+        {
+            const EncodeCode& code = codes[symbol];
+            if (code.length == 0)
+                continue;
+
+            uint8_t entry[6]{};
+            std::memcpy(entry, &code.code, sizeof(code.code));
+            entry[4] = static_cast<uint8_t>(symbol);
+            entry[5] = code.length;
+            res.insert(res.end(), std::begin(entry), std::end(entry));
+
+            numEntries++;
+        }
+
+        const uint32_t uncompressedSize = static_cast<uint32_t>(size);
+        std::memcpy(res.data(), &numEntries, sizeof(numEntries));
+        std::memcpy(res.data() + 2, &uncompressedSize, sizeof(uncompressedSize));
+
+        // Bits are written most significant first, a set bit selects the left node when decoding.
+        uint64_t bits = 0;
+        uint32_t numBits = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const EncodeCode& code = codes[data[i]];
+            bits = (bits << code.length) | code.code;
+            numBits += code.length;
+
+            while (numBits >= 8)
+            {
+                numBits -= 8;
+                res.push_back(static_cast<uint8_t>(bits >> numBits));
+            }
+        }
+
+        if (numBits != 0)
+        {
+            res.push_back(static_cast<uint8_t>(bits << (8 - numBits)));
+        }
+
+        return res;
+    }
+
+} // namespace openhedz
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace openhedz
+{
+    // Longest code the container can store, codes are kept in a 32 bit field.
+    inline constexpr uint32_t kMaxCodeLength = 32;
+
+    // Compresses data into the same container decompressText reads, a uint16 entry count and uint32
+    // uncompressed size followed by 6 byte {code, symbol, length} entries and the bitstream.
+    std::vector<uint8_t> compressText(const uint8_t* data, size_t size);
+
+} // namespace openhedz
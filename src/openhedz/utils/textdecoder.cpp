@@ -0,0 +1,221 @@
+#include "textdecoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace openhedz
+{
+    struct DecodeInfo
+    {
+        uint32_t numEntries;
+        uint32_t entryTableSizeInBytes;
+        uint32_t uncompressedSize;
+        uint32_t gap;
+        const uint8_t* pDataStart;
+    };
+
+    // 0x00424BC0
+    static void initTableEntry(std::vector<DecodeTableNode>& nodes, const uint8_t* buf)
+    {
+        const uint32_t code = *(uint32_t*)buf;
+        const uint8_t length = buf[5];
+
+        uint32_t cur = 0;
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            // The shift count is masked the same way the x86 shl in the original does.
+            const uint32_t bit = (code >> ((length - i - 1) & 31u)) & 1u;
+            if (nodes[cur].child[bit] == 0)
+            {
+                nodes[cur].child[bit] = static_cast<uint32_t>(nodes.size());
+                nodes.push_back({});
+            }
+            cur = nodes[cur].child[bit];
+        }
+        nodes[cur].byte = buf[4];
+    }
+
+    // 0x00424B40
+    static void buildDecodeTree(std::vector<DecodeTableNode>& nodes, const uint8_t* buf, uint32_t numEntries)
+    {
+        // Each code bit adds at most one node, reserving up front keeps the whole tree in one allocation.
+        size_t maxNodes = 1;
+        for (uint32_t i = 0; i < numEntries; ++i)
+        {
+            maxNodes += buf[i * 6 + 5];
+        }
+
+        nodes.clear();
+        nodes.reserve(maxNodes);
+        nodes.push_back({});
+
+        for (uint32_t i = 0; i < numEntries; ++i)
+        {
+            initTableEntry(nodes, buf + i * 6);
+        }
+
+        // Children are always created after their parent, walking backwards visits them first.
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            DecodeTableNode& node = nodes[i];
+            for (const uint32_t child : node.child)
+            {
+                if (child != 0)
+                    node.height = std::max(node.height, static_cast<uint8_t>(nodes[child].height + 1));
+            }
+        }
+    }
+
+    // Walks the tree bit by bit the same way the original decoder does, a set bit selects the left
+    // node and the walk stops at a leaf or when the selected node does not exist.
+    static uint8_t walkDecodeTree(const DecodeTableNode* nodes, uint32_t index, DecodeBitReader& reader)
+    {
+        const DecodeTableNode* node = &nodes[index];
+        while (node->height != 0)
+        {
+            if (reader.available == 0)
+                reader.loadByte();
+
+            const uint32_t next = node->child[reader.bits >> 63];
+            if (next == 0)
+                break;
+
+            reader.consume(1);
+            node = &nodes[next];
+        }
+        return node->byte;
+    }
+
+    static void buildDecodeLookup(DecodeLookup& lookup, const std::vector<DecodeTableNode>& nodes)
+    {
+        lookup.tables.push_back({ 0, std::min<uint32_t>(nodes[0].height, kLookupBits), 0 });
+        lookup.minSymbolBits = lookup.tables[0].bits;
+
+        for (size_t tableIndex = 0; tableIndex < lookup.tables.size(); ++tableIndex)
+        {
+            const DecodeLookupTable table = lookup.tables[tableIndex];
+            lookup.tables[tableIndex].offset = static_cast<uint32_t>(lookup.entries.size());
+
+            const uint32_t numPatterns = 1u << table.bits;
+            for (uint32_t pattern = 0; pattern < numPatterns; ++pattern)
+            {
+                uint32_t node = table.node;
+                uint32_t depth = 0;
+                while (nodes[node].height != 0 && depth < table.bits)
+                {
+                    const uint32_t bit = (pattern >> (table.bits - depth - 1)) & 1u;
+                    const uint32_t next = nodes[node].child[bit];
+                    if (next == 0)
+                        break;
+
+                    node = next;
+                    ++depth;
+                }
+
+                DecodeLookupEntry entry{};
+                entry.length = static_cast<uint8_t>(depth);
+                if (depth == table.bits && nodes[node].height != 0)
+                {
+                    entry.value = static_cast<uint32_t>(lookup.tables.size());
+                    entry.isLink = 1;
+                    lookup.tables.push_back({ 0, std::min<uint32_t>(nodes[node].height, kLookupBits), node });
+                }
+                else
+                {
+                    entry.value = nodes[node].byte;
+                    if (tableIndex == 0)
+                        lookup.minSymbolBits = std::min<uint32_t>(lookup.minSymbolBits, depth);
+                }
+                lookup.entries.push_back(entry);
+            }
+        }
+    }
+
+    // Decodes count symbols, remaining is the number of symbols left in the whole blob including these.
+    static void decodeSymbols(
+        const DecodeTableNode* nodes, const DecodeLookup& lookup, DecodeBitReader& reader, uint8_t* out, uint32_t count,
+        uint32_t remaining)
+    {
+        const DecodeLookupTable& rootTable = lookup.tables[0];
+        if (nodes[0].height == 0)
+        {
+            std::memset(out, nodes[0].byte, count);
+            return;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (reader.available < 32)
+            {
+                // Only bytes that the remaining symbols are guaranteed to consume are read ahead,
+                // the input size is not stored so anything beyond may not be readable.
+                const uint64_t minBits = reader.consumedBits() + uint64_t{ remaining - i } * lookup.minSymbolBits;
+                reader.refill(static_cast<uint32_t>(std::min<uint64_t>((minBits + 7) / 8, UINT32_MAX)));
+            }
+
+            const DecodeLookupTable* table = &rootTable;
+            for (;;)
+            {
+                if (reader.available < table->bits)
+                {
+                    out[i] = walkDecodeTree(nodes, table->node, reader);
+                    break;
+                }
+
+                const DecodeLookupEntry& entry = lookup.entries[table->offset + reader.peek(table->bits)];
+                reader.consume(entry.length);
+                if (entry.isLink == 0)
+                {
+                    out[i] = static_cast<uint8_t>(entry.value);
+                    break;
+                }
+                table = &lookup.tables[entry.value];
+            }
+        }
+    }
+
+    TextDecoder::~TextDecoder()
+    {
+        reset();
+    }
+
+    void TextDecoder::reset()
+    {
+        _nodes.clear();
+        _lookup.tables.clear();
+        _lookup.entries.clear();
+        _reader = {};
+        _headerSize = 0;
+        _uncompressedSize = 0;
+        _remaining = 0;
+    }
+
+    void TextDecoder::begin(const uint8_t* buf)
+    {
+        reset();
+
+        DecodeInfo info{};
+        info.numEntries = *(uint16_t*)buf;
+        info.uncompressedSize = *(uint32_t*)(buf + 2);
+        info.entryTableSizeInBytes = 6 * info.numEntries;
+        info.pDataStart = &buf[info.entryTableSizeInBytes + 6];
+
+        buildDecodeTree(_nodes, buf + 6, info.numEntries);
+        buildDecodeLookup(_lookup, _nodes);
+
+        _reader.data = info.pDataStart;
+        _headerSize = info.entryTableSizeInBytes + 6;
+        _uncompressedSize = info.uncompressedSize;
+        _remaining = info.uncompressedSize;
+    }
+
+    size_t TextDecoder::decodeInto(uint8_t* out, size_t size)
+    {
+        const uint32_t count = static_cast<uint32_t>(std::min<size_t>(size, _remaining));
+        decodeSymbols(_nodes.data(), _lookup, _reader, out, count, _remaining);
+
+        _remaining -= count;
+        return count;
+    }
+
+} // namespace openhedz
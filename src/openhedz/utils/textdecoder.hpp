@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace openhedz
+{
+    struct DecodeTableNode
+    {
+        // Index of the node selected by a clear or set code bit, the root is never a child so 0 means none.
+        uint32_t child[2];
+        uint8_t byte;
+        // Length of the longest path from this node to a leaf.
+        uint8_t height;
+    };
+
+    // Number of bits resolved by a single probe of a lookup table, codes that are longer
+    // continue in a subtable rooted at the node reached after those bits.
+    inline constexpr uint32_t kLookupBits = 10;
+
+    struct DecodeLookupEntry
+    {
+        // Output byte or the index of the subtable to continue in.
+        uint32_t value;
+        // Number of bits consumed by this entry.
+        uint8_t length;
+        uint8_t isLink;
+    };
+
+    struct DecodeLookupTable
+    {
+        uint32_t offset;
+        uint32_t bits;
+        uint32_t node;
+    };
+
+    struct DecodeLookup
+    {
+        std::vector<DecodeLookupTable> tables;
+        std::vector<DecodeLookupEntry> entries;
+        // Lower bound of bits consumed by any symbol, used to avoid reading past the input.
+        uint32_t minSymbolBits;
+    };
+
+    struct DecodeBitReader
+    {
+        const uint8_t* data;
+        uint32_t bytePos;
+        uint32_t available;
+        // Most significant bit is the next bit of the stream.
+        uint64_t bits;
+
+        void refill(uint32_t byteLimit)
+        {
+            while (available <= 56 && bytePos < byteLimit)
+            {
+                bits |= static_cast<uint64_t>(data[bytePos++]) << (56 - available);
+                available += 8;
+            }
+        }
+
+        void loadByte()
+        {
+            bits = static_cast<uint64_t>(data[bytePos++]) << 56;
+            available = 8;
+        }
+
+        uint32_t peek(uint32_t count) const
+        {
+            return static_cast<uint32_t>(bits >> (64 - count));
+        }
+
+        void consume(uint32_t count)
+        {
+            bits <<= count;
+            available -= count;
+        }
+
+        uint64_t consumedBits() const
+        {
+            return static_cast<uint64_t>(bytePos) * 8 - available;
+        }
+    };
+
+    // Holds all state required to decompress a single text blob, separate instances can be used
+    // concurrently from multiple threads.
+    class TextDecoder
+    {
+        std::vector<DecodeTableNode> _nodes;
+        DecodeLookup _lookup{};
+        DecodeBitReader _reader{};
+        uint32_t _headerSize = 0;
+        uint32_t _uncompressedSize = 0;
+        uint32_t _remaining = 0;
+
+    public:
+        TextDecoder() = default;
+        TextDecoder(const TextDecoder&) = delete;
+        TextDecoder& operator=(const TextDecoder&) = delete;
+
+        ~TextDecoder();
+
+        // Parses the header and code table of the compressed blob, the buffer must stay valid until decoding is done.
+        void begin(const uint8_t* buf);
+
+        // Decodes up to size bytes of the blob into out and returns the number of bytes written, can be
+        // called repeatedly to decode the blob in chunks.
+        size_t decodeInto(uint8_t* out, size_t size);
+
+        bool finished() const
+        {
+            return _remaining == 0;
+        }
+
+        uint32_t getUncompressedSize() const
+        {
+            return _uncompressedSize;
+        }
+
+        // Number of bytes of the compressed blob read so far, including the header and code table.
+        uint32_t getInputSize() const
+        {
+            return _headerSize + _reader.bytePos;
+        }
+
+    private:
+        void reset();
+    };
+
+} // namespace openhedz
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "textdecoder.hpp"
+
+#include <cstdint>
+
+namespace openhedz
+{
+    uint8_t* decompressText(const uint8_t* buf, uint32_t* outTotalSize);
+
+} // namespace openhedz
@@ -0,0 +1,109 @@
+#include "workerpool.hpp"
+
+#include <system_error>
+
+namespace openhedz
+{
+    WorkerPool::WorkerPool(size_t numWorkers)
+    {
+        _threads.reserve(numWorkers);
+        for (size_t i = 0; i < numWorkers; ++i)
+        {
+            try
+            {
+                _threads.emplace_back([this]() { workerThread(); });
+            }
+            catch (const std::system_error&)
+            {
+                break;
+            }
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wakeCv.notify_all();
+
+        for (auto& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    void WorkerPool::run(size_t count, const std::function<void(size_t)>& task)
+    {
+        std::lock_guard<std::mutex> runLock(_runMutex);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _count = count;
+            _next = 0;
+            _error = nullptr;
+            _busy = _threads.size();
+            _generation++;
+        }
+        _wakeCv.notify_all();
+
+        work();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _doneCv.wait(lock, [this]() { return _busy == 0; });
+        _task = nullptr;
+
+        if (_error)
+        {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void WorkerPool::workerThread()
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeCv.wait(lock, [&]() { return _stop || _generation != generation; });
+                if (_stop)
+                    return;
+                generation = _generation;
+            }
+
+            work();
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_busy == 0)
+            {
+                _doneCv.notify_one();
+            }
+        }
+    }
+
+    void WorkerPool::work()
+    {
+        for (size_t i = _next++; i < _count; i = _next++)
+        {
+            try
+            {
+                (*_task)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_error)
+                {
+                    _error = std::current_exception();
+                }
+                _next = _count;
+            }
+        }
+    }
+
+} // namespace openhedz
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openhedz
+{
+    // Threads that are started once and reused for every run, the calling thread takes part in the work
+    // instead of only waiting for it.
+    class WorkerPool
+    {
+        std::vector<std::thread> _threads;
+
+        // Only one run at a time, the state below belongs to it.
+        std::mutex _runMutex;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeCv;
+        std::condition_variable _doneCv;
+        uint64_t _generation = 0;
+        size_t _busy = 0;
+        bool _stop = false;
+
+        const std::function<void(size_t)>* _task = nullptr;
+        size_t _count = 0;
+        std::atomic<size_t> _next{ 0 };
+        std::exception_ptr _error;
+
+    public:
+        // Threads that fail to start are left out, the pool still works with fewer or none.
+        explicit WorkerPool(size_t numWorkers);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        size_t getNumWorkers() const
+        {
+            return _threads.size();
+        }
+
+        // Calls task for every index below count and returns once all calls are done. Indices are handed
+        // out one at a time so uneven work balances itself. The first exception thrown by the task stops
+        // handing out indices and is rethrown here.
+        void run(size_t count, const std::function<void(size_t)>& task);
+
+    private:
+        void workerThread();
+        void work();
+    };
+
+} // namespace openhedz